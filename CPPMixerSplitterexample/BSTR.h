@@ -40,10 +40,37 @@ class CBSTR
  */
 
  CBSTR(const CBSTR &other) 
-  {if (&other!=this)
-    value=SysAllocString(other.value);
+  {value=NULL;
+   if (other.value)
+    if (*other.value)
+     value=SysAllocString(other.value);
+  }
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1600)
+
+ //! Move constructor.
+ /*!
+   Takes over the value of a temporary, such as the return value of CVariant::GetStringAt, without copying
+ */
+
+ CBSTR(CBSTR &&other) 
+  {value=other.value;
+   other.value=NULL;
   }
 
+ //! Move assignment
+ /*!
+   Takes over the value of a temporary, without copying
+ */
+
+ void operator=(CBSTR &&other)
+ {BSTR b=value;
+  value=other.value;
+  other.value=b; //freed by other
+ }
+
+#endif
+
  //! Constructor.
  /*!
    Constructor that allocated a BSTR value given a string value
@@ -80,7 +107,7 @@ class CBSTR
    Set from a CBSTR value; the value will be copied
  */
 
- void operator=(const CBSTR other)
+ void operator=(const CBSTR &other)
  {if (&other!=this)
    {if (value) SysFreeString(value);
     value=NULL;
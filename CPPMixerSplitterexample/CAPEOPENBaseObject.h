@@ -15,10 +15,29 @@
   Implements basic error handling and identification
   which every CAPE-OPEN object should implement.
   All CAPE-OPEN objects derive from this class
+
+  The objects are thread-safe: the COM reference count is maintained
+  with interlocked operations and every object carries its own critical
+  section (via CComMultiThreadModel), which is used to protect the 
+  identification and error members. Derived classes use the same object
+  lock (ObjectLock) to protect their own state. The unit operation is
+  nevertheless registered with the apartment threading model, as it
+  holds apartment-bound references to the material objects of the 
+  simulation environment, and the module is built for the apartment 
+  model (_ATL_APARTMENT_THREADED). The object locks remain, as the worker
+  threads of concurrent feed calculations and the process-wide caches
+  run outside the apartment; they protect the state that is shared 
+  between the instances and with those threads.
+
+  Names and descriptions are string literals that are shared by all 
+  instances, such as the names of ports and parameters; a copy is only 
+  allocated when an object is renamed. Likewise, the interface and 
+  scope of the last error are string literals. This keeps the footprint
+  of objects small in flowsheets with many unit operations.
 */
 
 class CAPEOPENBaseObject :
-  public CComObjectRootEx<CComSingleThreadModel>,
+  public CComObjectRootEx<CComMultiThreadModel>,
   public IDispatchImpl<ECapeRoot, &__uuidof(ECapeRoot), &LIBID_CAPEOPEN110, /* wMajor = */ 1, /* wMinor = */ 1>,
   public IDispatchImpl<ECapeUnknown, &__uuidof(ECapeUnknown), &LIBID_CAPEOPEN110, /* wMajor = */ 1, /* wMinor = */ 1>,
   public IDispatchImpl<ECapeUser, &__uuidof(ECapeUser), &LIBID_CAPEOPEN110, /* wMajor = */ 1, /* wMinor = */ 1>,
@@ -35,14 +54,17 @@ public:
       if no name is given at time of construction, one should provide a name immediately
       after construction.
       \param canRename should be true for classes of which the name and description may be changed by external applications.
-      \param name the initial name, optional
-      \param description the initial description, optional
+      \param name the initial name, optional; must be a string literal
+      \param description the initial description, optional; must be a string literal
+      \sa SetIdentification()
     */
 
 	CAPEOPENBaseObject(bool canRename, const OLECHAR *name=NULL, const OLECHAR *description=NULL)
 	 {this->canRename=canRename; //determines whether external objects are allowed to rename this object
-	  if (name) this->name=name; //if a name is not provided with the constructor, make sure to set after construction 
-	  if (description) this->description=description;
+	  staticName=name; //if a name is not provided with the constructor, make sure to set after construction 
+	  staticDescription=description;
+	  renamedName=renamedDescription=NULL;
+	  errIface=errScope=NULL;
 	  dirty=false; //nothing has changed
 	 }
 
@@ -53,17 +75,83 @@ public:
     */
 
 	virtual ~CAPEOPENBaseObject()
-	 {
+	 {if (renamedName) delete renamedName;
+	  if (renamedDescription) delete renamedDescription;
 	 }
 
 	//member variables
 	bool canRename;         /*!< can this object be renamed? */
-	wstring name;           /*!< the name of this object */
-	wstring description;	/*!< the description of this object */
+	const OLECHAR *staticName; /*!< the initial name of this object, a string literal */
+	const OLECHAR *staticDescription; /*!< the initial description of this object, a string literal, can be NULL */
+	wstring *renamedName;   /*!< the name of this object after renaming, NULL if not renamed */
+	wstring *renamedDescription; /*!< the description of this object after renaming, NULL if not renamed */
 	wstring errDesc;        /*!< the description of the last error, also used as the error name */
-	wstring errIface;       /*!< the interface of the last error, e.g. ICapeUnit */
-	wstring errScope;       /*!< the scope of the last error, e.g. Validate */
+	const OLECHAR *errIface; /*!< the interface of the last error, e.g. ICapeUnit; a string literal */
+	const OLECHAR *errScope; /*!< the scope of the last error, e.g. Validate; a string literal */
 	bool dirty;             /*!< set if something has changed that needs to be saved */
+
+	//! Set the name and description
+    /*!
+      Sets the initial name and description, for objects of which the name is not passed to the 
+      constructor. No copy is made, so the values must be string literals or otherwise remain valid
+      during the life time of this object
+      \param name the name
+      \param description the description, can be NULL
+    */
+
+	void SetIdentification(const OLECHAR *name,const OLECHAR *description)
+	{staticName=name;
+	 staticDescription=description;
+	}
+
+	//! Get the name
+    /*!
+      If the object can be renamed, the object lock must be held while using the returned value
+      \return the name of this object
+      \sa SetName()
+    */
+
+	const OLECHAR *GetName()
+	{if (renamedName) return renamedName->c_str();
+	 return (staticName)?staticName:L"";
+	}
+
+	//! Get the description
+    /*!
+      If the object can be renamed, the object lock must be held while using the returned value
+      \return the description of this object
+      \sa SetDescription()
+    */
+
+	const OLECHAR *GetDescription()
+	{if (renamedDescription) return renamedDescription->c_str();
+	 return (staticDescription)?staticDescription:L"";
+	}
+
+	//! Set the name
+    /*!
+      Renames the object; a copy of the name is stored. The object lock must be held
+      \param name the new name
+      \sa GetName()
+    */
+
+	void SetName(const OLECHAR *name)
+	{if (renamedName) *renamedName=name;
+	 else renamedName=new wstring(name);
+	}
+
+	//! Set the description
+    /*!
+      Sets a new description; a copy of the description is stored. The object lock must be held
+      \param description the new description, can be NULL
+      \sa GetDescription()
+    */
+
+	void SetDescription(const OLECHAR *description)
+	{if (!description) description=L"";
+	 if (renamedDescription) *renamedDescription=description;
+	 else renamedDescription=new wstring(description);
+	}
 	
 	//! ECapeRoot::SetError
     /*!
@@ -71,8 +159,8 @@ public:
       returning a CAPE-OPEN error code, and can later on be obtained by the caller of this
       object via the CAPE-OPEN error interfaces ECapeRoot, ECapeUnknown and ECapeUser
       \param desc description of the last error, cannot be empty or NULL
-      \param iface interface of the last error, cannot be empty or NULL. E.g. ICapeUnitPort
-      \param scope scope of the last error, cannot be empty or NULL. E.g Connect
+      \param iface interface of the last error, cannot be empty or NULL. E.g. ICapeUnitPort. Must be a string literal
+      \param scope scope of the last error, cannot be empty or NULL. E.g Connect. Must be a string literal
       \sa get_name(), get_description(), get_scope(), get_interfaceName()
     */
     
@@ -84,6 +172,7 @@ public:
      ATLASSERT(*iface);
      ATLASSERT(scope);
      ATLASSERT(*scope);
+     ObjectLock lock(this); //error may be read from another thread
      errDesc=desc;
      errScope=scope;
      errIface=iface;
@@ -102,6 +191,7 @@ public:
 	STDMETHOD(get_name)(BSTR * name)
 	{	//return the name of the last error (we return its decription)
 	 	if (!name) return E_POINTER; //invalid pointer
+	    ObjectLock lock(this);
 	    ATLASSERT(errDesc.size()!=0);
 	    *name=SysAllocString(errDesc.c_str());
 		return NOERROR;
@@ -133,6 +223,7 @@ public:
 	STDMETHOD(get_description)(BSTR * description)
 	{	//return the last error description
 	    if (!description) return E_POINTER; //invalid pointer
+	    ObjectLock lock(this);
 	    ATLASSERT(errDesc.size()!=0);
 	    *description=SysAllocString(errDesc.c_str());
 		return NOERROR;
@@ -148,8 +239,9 @@ public:
 	STDMETHOD(get_scope)(BSTR * scope)
 	{   //return the last error scope
 	    if (!scope) return E_POINTER; //invalid pointer
-	    ATLASSERT(errScope.size()!=0);
-	    *scope=SysAllocString(errScope.c_str());
+	    ObjectLock lock(this);
+	    ATLASSERT(errScope!=NULL);
+	    *scope=SysAllocString(errScope);
 		return NOERROR;
 	}
 
@@ -163,8 +255,9 @@ public:
 	STDMETHOD(get_interfaceName)(BSTR * interfaceName)
 	{   //return the last error interface
 	    if (!interfaceName) return E_POINTER; //invalid pointer
-	    ATLASSERT(errIface.size()!=0);
-	    *interfaceName=SysAllocString(errIface.c_str());
+	    ObjectLock lock(this);
+	    ATLASSERT(errIface!=NULL);
+	    *interfaceName=SysAllocString(errIface);
 		return NOERROR;
 	}
 
@@ -207,8 +300,9 @@ public:
 
 	STDMETHOD(get_ComponentName)(BSTR * name)
 	{	if (!name) return E_POINTER; //invalid pointer
-		ATLASSERT(this->name.size()>0);
-		*name=SysAllocString(this->name.c_str());
+		ObjectLock lock(this);
+		ATLASSERT(*GetName());
+		*name=SysAllocString(GetName());
 		return NO_ERROR;
 	}
 
@@ -233,7 +327,8 @@ public:
 	     {SetError(L"The name of this object cannot be empty",L"ICapeIdentification",L"put_ComponentName");
 	      return ECapeUnknownHR;
 	     }
-	    this->name=name;
+	    ObjectLock lock(this);
+	    SetName(name);
 	    dirty=true; //something changed that affects saving
 		return NO_ERROR;
 	}	
@@ -248,8 +343,10 @@ public:
 	
 	STDMETHOD(get_ComponentDescription)(BSTR * desc)
 	{   if (!desc) return E_POINTER; //invalid pointer
-	    if (this->description.size()==0) *desc=NULL;
-	    else *desc=SysAllocString(this->description.c_str());
+	    ObjectLock lock(this);
+	    const OLECHAR *description=GetDescription();
+	    if (!*description) *desc=NULL;
+	    else *desc=SysAllocString(description);
 		return NO_ERROR;
 	}
 	
@@ -265,8 +362,8 @@ public:
 	     {SetError(L"The description of this object is read-only",L"ICapeIdentification",L"put_ComponentDescription");
 	      return ECapeUnknownHR;
 	     }
-	    if (!desc) this->description.clear();
-	    else this->description=desc;
+	    ObjectLock lock(this);
+	    SetDescription(desc);
 	    dirty=true; //something changed that affects saving
 		return NO_ERROR;
 	}
@@ -25,4 +25,71 @@
 *this example as you please. Under no circumstance can CO-LaN or 
 *AmsterCHEM be held liable for consequential or any other damages
 *resulting from this code.
+*
+*\section threading Calculating unit operations concurrently
+*
+*The unit operation is registered with the apartment threading model;
+*it holds references to the material objects of the simulation
+*environment, which are bound to the apartment in which they were
+*obtained. A simulation environment that calculates independent branches
+*of a flowsheet in parallel can rely on the following:
+*- different instances of the unit operation that were created in
+*  different single-threaded apartments can be validated and calculated
+*  concurrently, each on the thread of its apartment; an instance keeps
+*  all state of a calculation in local variables and its ports, and
+*  shares with other instances only the ObjectPool, the
+*  ThermoMetadataCache, the CalculationStatistics, the FlashCache and the
+*  ThermoIdentifiers, which are thread-safe or immutable after module load
+*- all calls to an instance arrive on the thread of its apartment; a
+*  client in the multi-threaded apartment calls the instance through a
+*  proxy, so its calls are serialized. A call that re-enters the instance
+*  during a calculation, while the simulation environment processes
+*  messages, is rejected for Calculate and Validate
+*
+*The simulation environment is responsible for the following:
+*- a unit operation is calculated only after the unit operations that
+*  produce its feeds have finished; a material object must not be
+*  written by one unit operation while another one reads it
+*- material objects are called on the thread that calculates the unit
+*  operation; with "Parallel feeds" set, the two feeds of an instance are
+*  read concurrently on worker threads, but only if the feed material
+*  objects aggregate the free-threaded marshaler. Unit operations that
+*  are calculated in parallel should each have their own material objects
+*
+*The repository does not include a parallel flowsheet driver; the
+*"Diagnostics" report gives the calculation throughput of an instance
+*and the process-wide number of thermo calls, which a driver can use to
+*measure scaling.
 */
+
+//! NaN, used for parameters without bounds
+static const double NaN=numeric_limits<double>::quiet_NaN();
+
+//port definitions; feeds first, then products
+const MaterialPortSpec CCPPMixerSplitterUnitOperation::portDefinitions[PORTCOUNT]=
+{	{L"Feed 1",L"Feed port for CPP Mixer Splitter Unit Operation example",CAPE_INLET}, //item 0
+	{L"Feed 2",L"Feed port for CPP Mixer Splitter Unit Operation example",CAPE_INLET}, //item 1
+	{L"Product 1",L"Product port for CPP Mixer Splitter Unit Operation example",CAPE_OUTLET}, //item 2
+	{L"Product 2",L"Product port for CPP Mixer Splitter Unit Operation example",CAPE_OUTLET}, //item 3
+};
+
+//parameter definitions; the dimensionality of heat input and heat duty is W = J / s = kg m ^2 / s ^3, that of the linearization limit is J / mol = kg m ^2 / s ^2 / mol
+const RealParameterSpec CCPPMixerSplitterUnitOperation::parameterDefinitions[PARAMETERCOUNT]=
+{	{L"Split factor",L"Split factor: fraction of product that goes to Product 1 stream",CAPE_INPUT,0,1,0.5,0,{0,0,0}}, //parameter 0
+	{L"Heat input",L"Heat input: energy added to the total product, if the heat input is specified",CAPE_INPUT,NaN,NaN,0,3,{2,1,-3}}, //parameter 1
+	{L"Parallel feeds",L"Parallel feeds: 1 to calculate the feeds concurrently if the material objects are free-threaded, 0 to calculate them in sequence",CAPE_INPUT,0,1,0,0,{0,0,0}}, //parameter 2
+	{L"Time budget",L"Time budget: maximum duration of a calculation, 0 for no limit",CAPE_INPUT,0,NaN,0,3,{0,0,1}}, //parameter 3
+	{L"Progress reporting",L"Progress reporting: 1 to log the progress of the calculation to the simulation environment, 0 not to log progress",CAPE_INPUT,0,1,0,0,{0,0,0}}, //parameter 4
+	{L"Specification",L"Specification: 0 to specify the heat input, 1 to specify the outlet temperature and calculate the heat duty",CAPE_INPUT,0,1,0,0,{0,0,0}}, //parameter 5
+	{L"Outlet temperature",L"Outlet temperature: product temperature if the outlet temperature is specified",CAPE_INPUT,0,NaN,298.15,5,{0,0,0,0,1}}, //parameter 6
+	{L"Heat duty",L"Heat duty: energy added to the total product in the last calculation",CAPE_OUTPUT,NaN,NaN,0,3,{2,1,-3}}, //parameter 7
+	{L"Output tolerance",L"Output tolerance: relative change in product flow, temperature and pressure, and absolute change in mole fractions, below which the products are not rewritten; 0 to rewrite on any change",CAPE_INPUT,0,1,0,0,{0,0,0}}, //parameter 8
+	{L"Linearization limit",L"Linearization limit: maximum change in product molar enthalpy since the last PH flash for which the product temperature is extrapolated with the product heat capacity instead of calculated by a PH flash, if the estimated error of the extrapolated temperature is at most 0.01 K; 0 to always flash",CAPE_INPUT,0,NaN,0,6,{2,1,-2,0,0,-1}}, //parameter 9
+	{L"Flash cache",L"Flash cache: tag of the flowsheet, an integer from 1 to 65535, to share PH flash results with the processes on this machine that calculate flowsheets with the same tag through a file in the temporary folder; 0 not to use the flash cache",CAPE_INPUT,0,FLASHCACHEMAXTAG,0,0,{0,0,0}}, //parameter 10
+};
+
+//report names
+const OLECHAR *CCPPMixerSplitterUnitOperation::reportNames[REPORTCOUNT]=
+{	L"Sample report", //report 0
+	L"Diagnostics", //report 1
+};
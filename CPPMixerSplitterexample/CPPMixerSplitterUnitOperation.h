@@ -8,9 +8,16 @@
 #include "Collection.h"
 #include "RealParameter.h"
 #include "MaterialPort.h"
+#include "FeedStage.h"
+#include "LinearizedState.h"
+#include "FlashCache.h"
 #include "EditDialog.h"
 
-#define CURRENTFILEVERSIONNUMBER 0
+#define CURRENTFILEVERSIONNUMBER 4
+#define PORTCOUNT 4 //number of ports
+#define PARAMETERCOUNT 11 //number of parameters
+#define REPORTCOUNT 2 //number of reports
+#define MAXPERSISTSIZE (64*1024*1024) //maximum size of the saved data; larger sizes indicate an invalid file
 
 //! Unit operation implementation class
 /*!
@@ -29,6 +36,16 @@
   objects and CAPE-OPEN Unit Operations, as well as the 
   CapeDescription key and its values.
   
+  The unit operation is registered with the apartment threading model:
+  an instance is called on the thread of the apartment that created it,
+  and so are the material objects connected to its ports. A simulation
+  environment can calculate independent unit operations that were 
+  created in different apartments on different threads. Calculate and 
+  Validate are serialized per unit operation by the calculation lock; 
+  all state of a single calculation is kept in local variables. 
+  Short-lived access to the shared members is protected by the object 
+  lock, parameters and ports protect their own state.
+  
 */
 
 class ATL_NO_VTABLE CCPPMixerSplitterUnitOperation :
@@ -46,16 +63,31 @@ public:
 	//data members
 
 	CapeValidationStatus valStatus; /*!< current valiation status */
-	CollectionObject *portCollection; /*!< the port collection */
-	CollectionObject *parameterCollection; /*!< the parameter collection */
+	CollectionObject * volatile portCollection; /*!< the port collection, NULL until first access; use GetPortCollection() */
+	CollectionObject * volatile parameterCollection; /*!< the parameter collection, NULL until first access; use GetParameterCollection() */
 	IDispatch *simulationContext; /*!< reference to the simulation context, if any */
 	int nCompounds; /*!< number of compounds; set at Validate(), used at Calculate() */
+	int thermoVersion; /*!< thermo version of all connected material objects, 10 or 11, or 0 if mixed; set at Validate(), used at Calculate() */
 	int selectedReportIndex; /*!< index of the currently selected report, -1 if no report selected */
+	CComAutoCriticalSection calculationLock; /*!< serializes Calculate and Validate on this unit operation */
+	CalculationControl *activeControl; /*!< the control of the calculation in progress, NULL if not calculating */
+	ConvergedState convergedState; /*!< last converged solution of the PH flash, saved with the unit operation; protected by the object lock */
+	PersistBuffer persistBuffer; /*!< buffer for Load and Save, kept for reuse; protected by the object lock */
+	bool outputsChanged; /*!< set if the last calculation changed a product; protected by the object lock */
+	ULONG changedCalculations; /*!< number of calculations that changed a product; protected by the object lock */
+	ULONG unchangedCalculations; /*!< number of calculations that did not change any product; protected by the object lock */
+	ULONG calculationCount; /*!< number of calculations, including failed calculations; protected by the object lock */
+	LONGLONG calculationTime; /*!< total duration of the calculations, in performance counter ticks; protected by the object lock */
+	LinearizedState linearizedState; /*!< state and heat capacity of the product at the last PH flash; protected by the object lock */
+	ULONG linearizedCalculations; /*!< number of calculations with an extrapolated product temperature; protected by the object lock */
+	double linearizationErrorEstimate; /*!< estimated error of the last extrapolated product temperature [K]; protected by the object lock */
 
 	//! Constructor
 	/*!
 	Calls the constructor of the CAPEOPENBaseObject base class with name and description initializers
-	and initializes variables
+	and initializes variables. The ports and parameters are not created here, but on first access;
+	simulation environments create all unit operations when loading a flowsheet.
+	\sa GetPortCollection(), GetParameterCollection()
 	*/
 
 	CCPPMixerSplitterUnitOperation() : 
@@ -66,36 +98,19 @@ public:
 	{//init variables
 		valStatus=CAPE_NOT_VALIDATED;
 		simulationContext=NULL;
+		activeControl=NULL;
+		thermoVersion=0;
 		dirty=false;
 		selectedReportIndex=-1;
-		//create port collection
-		portCollection=CCollection::CreateCollection(L"Port collection",L"Port collection for CPP Mixer Splitter");
-		//create the ports
-		MaterialPortObject *port;
-		port=MaterialPortObject::CreateMaterialPort(L"Feed 1",L"Feed port for CPP Mixer Splitter Unit Operation example",CAPE_INLET);
-		portCollection->AddItem(port); //item 0
-		port=MaterialPortObject::CreateMaterialPort(L"Feed 2",L"Feed port for CPP Mixer Splitter Unit Operation example",CAPE_INLET);
-		portCollection->AddItem(port); //item 1
-		port=MaterialPortObject::CreateMaterialPort(L"Product 1",L"Product port for CPP Mixer Splitter Unit Operation example",CAPE_OUTLET);
-		portCollection->AddItem(port); //item 2
-		port=MaterialPortObject::CreateMaterialPort(L"Product 2",L"Product port for CPP Mixer Splitter Unit Operation example",CAPE_OUTLET);
-		portCollection->AddItem(port); //item 3
-		//create parameter collection
-		parameterCollection=CCollection::CreateCollection(L"Parameter collection",L"Parameter collection for CPP Mixer Splitter");
-		//create the parameters
-		RealParameterObject *par;
-		vector<double> dimensionality; //order: m, kg, S, A, K, mole, cd, rad, optionally followed by a delta indicator; trailing zeroes can be omitted
-		dimensionality.resize(0); //no dimension for this parameter
-		par=RealParameterObject::CreateParameter(L"Split factor",L"Split factor: fraction of product that goes to Product 1 stream",0,1,0.5,dimensionality,&valStatus); 
-		parameterCollection->AddItem(par); //parameter 0
-		//the dimensionality of heat input is W = J / s = kg m ^2 / s ^3
-		dimensionality.resize(3);
-		dimensionality[0]=2.0; //m
-		dimensionality[1]=1.0; //kg
-		dimensionality[2]=-3.0; //s
-		double NaN=numeric_limits<double>::quiet_NaN();
-		par=RealParameterObject::CreateParameter(L"Heat input",L"Heat input: energy added to the total product",NaN,NaN,0,dimensionality,&valStatus); //no min or max value, we pass NaN
-		parameterCollection->AddItem(par); //parameter 1
+		outputsChanged=false;
+		changedCalculations=unchangedCalculations=0;
+		calculationCount=0;
+		calculationTime=0;
+		linearizedCalculations=0;
+		linearizationErrorEstimate=0;
+		//the collections are created on first access
+		portCollection=NULL;
+		parameterCollection=NULL;
 	}
 
 	//! Destructor
@@ -107,14 +122,94 @@ public:
 	{	unsigned int i;
 		//in case terminate has not been called, clean up references to external objects
 		Terminate();
-		//clean up ports
-		for (i=0;i<portCollection->items.size();i++) ((ICapeIdentification*)portCollection->items[i])->Release(); //it does not matter which Release we use, but we have to cast to one of the implemented interfaces as the C++ compiler wants to know which Release we mean
-		//clean up port collection
-		portCollection->Release();
-		//clean up parameters
-		for (i=0;i<parameterCollection->items.size();i++) ((ICapeIdentification*)parameterCollection->items[i])->Release();
-		//clean up parameter collection
-		parameterCollection->Release();
+		if (portCollection)
+		   {//clean up ports
+			for (i=0;i<portCollection->items.size();i++) ((ICapeIdentification*)portCollection->items[i])->Release(); //it does not matter which Release we use, but we have to cast to one of the implemented interfaces as the C++ compiler wants to know which Release we mean
+			//clean up port collection
+			portCollection->Release();
+		   }
+		if (parameterCollection)
+		   {//clean up parameters
+			for (i=0;i<parameterCollection->items.size();i++) ((ICapeIdentification*)parameterCollection->items[i])->Release();
+			//clean up parameter collection
+			parameterCollection->Release();
+		   }
+	}
+
+	//! Port and parameter definitions
+	/*!
+	The ports and parameters are created from these definitions on first access; until then, the parameters 
+	have their default values. The definitions are shared by all instances of the unit operation; the ports
+	and parameters refer to them rather than holding a copy.
+	\sa GetPortCollection(), GetParameterCollection(), GetParameterValue()
+	*/
+
+	static const MaterialPortSpec portDefinitions[PORTCOUNT]; /*!< the ports: feeds 0 and 1, products 2 and 3 */
+	static const RealParameterSpec parameterDefinitions[PARAMETERCOUNT]; /*!< the parameters, in order of the parameter collection */
+	static const OLECHAR *reportNames[REPORTCOUNT]; /*!< the reports: sample report and diagnostics */
+
+	//! Get the port collection
+	/*!
+	Returns the port collection, creating it on first access. Instances that are created but never
+	used, such as at flowsheet load, do not create ports. Can be called from any thread.
+	\return the port collection
+	\sa portDefinitions
+	*/
+
+	CollectionObject *GetPortCollection()
+	{	if (!portCollection)
+		   {ObjectLock lock(this);
+			if (!portCollection)
+			   {int i;
+				MaterialPortObject *port;
+				CollectionObject *collection=CCollection::CreateCollection(L"Port collection",L"Port collection for CPP Mixer Splitter");
+				for (i=0;i<PORTCOUNT;i++)
+				   {port=MaterialPortObject::CreateMaterialPort(portDefinitions+i,&valStatus);
+					collection->AddItem(port); //item i
+				   }
+				portCollection=collection; //set when complete; other threads check without lock
+			   }
+		   }
+		return portCollection;
+	}
+
+	//! Get the parameter collection
+	/*!
+	Returns the parameter collection, creating it on first access. Can be called from any thread.
+	\return the parameter collection
+	\sa parameterDefinitions, GetParameterValue()
+	*/
+
+	CollectionObject *GetParameterCollection()
+	{	if (!parameterCollection)
+		   {ObjectLock lock(this);
+			if (!parameterCollection)
+			   {int i;
+				RealParameterObject *par;
+				CollectionObject *collection=CCollection::CreateCollection(L"Parameter collection",L"Parameter collection for CPP Mixer Splitter");
+				for (i=0;i<PARAMETERCOUNT;i++)
+				   {par=RealParameterObject::CreateParameter(parameterDefinitions+i,&valStatus);
+					collection->AddItem(par); //parameter i
+				   }
+				parameterCollection=collection; //set when complete; other threads check without lock
+			   }
+		   }
+		return parameterCollection;
+	}
+
+	//! Get the value of a parameter
+	/*!
+	Returns the value of a parameter, without creating the parameter collection; if it does not 
+	exist, the default value is returned. Can be called from any thread.
+	\param index index of the parameter
+	\return the value
+	*/
+
+	double GetParameterValue(int index)
+	{	ATLASSERT((index>=0)&&(index<PARAMETERCOUNT));
+		CollectionObject *collection=parameterCollection;
+		if (collection) return ((RealParameterObject *)collection->items[index])->GetValue();
+		return parameterDefinitions[index].defaultValue;
 	}
 
 	//! Registration entry points
@@ -154,8 +249,9 @@ public:
 	STDMETHOD(get_ports)(LPDISPATCH * ports)
 	{	if (!ports) return E_POINTER; //invalid pointer
 		//instead of doing this, we can also call QueryInterface on the port collection
-		*ports=(ICapeCollection*)portCollection;
-		portCollection->AddRef(); //the caller must release this object
+		CollectionObject *collection=GetPortCollection();
+		*ports=(ICapeCollection*)collection;
+		collection->AddRef(); //the caller must release this object
 		//all done
 		return NOERROR;
 	}
@@ -175,10 +271,136 @@ public:
 	//! ICapeUnit::Calculate
 	/*!
 	Calculate the unit operation. This is the function that performs the actual model calculation.
-	\sa Calculate()
+	The calculation itself is performed by CalculatePipeline, on the calling thread, as the material
+	objects are bound to its apartment. If progress reporting is set, the progress is logged to the
+	simulation context at each stage of the calculation. The calculation stops with ECapeTimeOutHR 
+	if the time budget is exhausted, and can be cancelled with CancelCalculation(); cancellation is
+	cooperative, the calculation checks for it between calls to the material objects.
+	\sa CalculatePipeline(), CancelCalculation()
 	*/
 
 	STDMETHOD(Calculate)()
+	{	CComCritSecLock<CComAutoCriticalSection> calculating(calculationLock);
+		HRESULT hr;
+		int nCompounds; //copy of the number of compounds, obtained at validation
+		int thermoVersion; //copy of the thermo version, obtained at validation
+		CapeValidationStatus currentValStatus;
+		//take a snapshot of the state shared with other threads
+		Lock();
+		currentValStatus=valStatus;
+		nCompounds=this->nCompounds;
+		thermoVersion=this->thermoVersion;
+		bool reentered=(activeControl!=NULL);
+		Unlock();
+		//while the simulation environment processes a progress message, we may be called again on the same thread
+		if (reentered)
+		 {SetError(L"A calculation is already in progress",L"ICapeUnit",L"Calculate");
+		  return ECapeBadInvOrderHR;
+		 }
+		//first let us make sure we are in a valid state
+		if (currentValStatus==CAPE_INVALID)
+		 {SetError(L"Unit is not valid",L"ICapeUnit",L"Calculate");
+		  return ECapeUnknownHR;
+		 }
+		if (currentValStatus==CAPE_NOT_VALIDATED)
+		 {SetError(L"Unit has not been validated",L"ICapeUnit",L"Calculate");
+	   	  return ECapeUnknownHR;
+		 }
+		ATLASSERT(currentValStatus==CAPE_VALID);
+		//set up the control for this calculation
+		CalculationControl control(GetParameterValue(3)); //time budget
+		Lock();
+		if ((GetParameterValue(4)!=0)&&(simulationContext)) control.SetProgressLog(simulationContext,GetName()); //progress reporting
+		activeControl=&control;
+		Unlock();
+		hr=CalculatePipeline(nCompounds,thermoVersion,control);
+		Lock();
+		activeControl=NULL;
+		Unlock();
+		return hr;
+	}
+
+	//! Cancel the current calculation
+	/*!
+	Requests the calculation that is currently in progress, if any, to stop. The calculation
+	stops at the next check between calls to the material objects and Calculate returns an error. 
+	Called by Terminate, which can only arrive during a calculation if the simulation environment
+	re-enters the unit operation while it processes a call made by the calculation, such as a 
+	progress message.
+	\sa Calculate()
+	*/
+
+	void CancelCalculation()
+	{	ObjectLock lock(this);
+		if (activeControl) activeControl->Cancel();
+	}
+
+	//! Stop the calculation with an error
+	/*!
+	Sets the error and returns the error code; this is ECapeTimeOutHR if the time budget of the 
+	calculation was exhausted
+	\param control the control of the calculation
+	\param error description of the error
+	\return the error code
+	*/
+
+	HRESULT CalculationError(CalculationControl &control,const wstring &error)
+	{	SetError(error.c_str(),L"ICapeUnit",L"Calculate");
+		return (control.TimedOut())?ECapeTimeOutHR:ECapeUnknownHR;
+	}
+
+	//! Calculation pipeline
+	/*!
+	Performs the actual model calculation, by running the pipeline that is instantiated for the 
+	thermo version of the connected material objects. If the material objects are of different 
+	versions, the pipeline that calls the material objects through virtual functions is used. 
+	Connecting a port invalidates the unit operation, but the version of each connected material
+	object is checked again here, as the static dispatch relies on it.
+	\param nCompounds number of compounds
+	\param thermoVersion thermo version selected at validation, 10 or 11, or 0 if mixed
+	\param control the control of the calculation
+	\return NOERROR in case of success, or an error code
+	\sa Calculate(), RunPipeline()
+	*/
+
+	HRESULT CalculatePipeline(int nCompounds,int thermoVersion,CalculationControl &control)
+	{	HRESULT hr;
+		LARGE_INTEGER start,end;
+		unsigned int i;
+		QueryPerformanceCounter(&start);
+		//a port may have been connected to a material object of another version since validation
+		for (i=0;(i<GetPortCollection()->items.size())&&(thermoVersion);i++)
+		   {MaterialPortObject *port=(MaterialPortObject *)GetPortCollection()->items[i];
+			if ((port->IsConnected())&&(port->GetThermoVersion()!=thermoVersion)) thermoVersion=0;
+		   }
+		switch (thermoVersion)
+		   {case 10: hr=RunPipeline<MaterialObject10Wrapper>(nCompounds,control);break;
+			case 11: hr=RunPipeline<MaterialObject11Wrapper>(nCompounds,control);break;
+			default: hr=RunPipeline<MaterialObjectWrapper>(nCompounds,control);break;
+		   }
+		QueryPerformanceCounter(&end);
+		//throughput statistics
+		CalculationStatistics::CountCalculation();
+		Lock();
+		calculationCount++;
+		calculationTime+=end.QuadPart-start.QuadPart;
+		Unlock();
+		return hr;
+	}
+
+	//! Calculation pipeline for a material object wrapper type
+	/*!
+	Performs the actual model calculation. All state of the calculation is kept in local variables, 
+	so that this function can be executed on any thread. The calculation control is checked between
+	calls to the material objects. The material objects are accessed through MaterialAccess<W>, so
+	that the calls to the wrapper are not virtual if W is MaterialObject10Wrapper or MaterialObject11Wrapper.
+	\param nCompounds number of compounds
+	\param control the control of the calculation
+	\return NOERROR in case of success, or an error code
+	\sa CalculatePipeline(), MaterialAccess
+	*/
+
+	template <class W> HRESULT RunPipeline(int nCompounds,CalculationControl &control)
 	{	unsigned int i;
 		int j,k;
 		double d;
@@ -186,131 +408,103 @@ public:
 		MaterialPortObject *port;
 		double pressure; //[Pa]
 		double temperature; //[K]
-		double phaseFraction; //[mol/mol]
 		vector<double> componentFlows; //[mol/s]
 		double totalFlow,flow; //[mol/s]
 		double enthalpy; //[J/s]
-		CVariant value,phaseList;
 		Material material,duplicateMaterial;
-		//first let us make sure we are in a valid state
-		if (valStatus==CAPE_INVALID)
-		 {SetError(L"Unit is not valid",L"ICapeUnit",L"Calculate");
-		  return ECapeUnknownHR;
-		 }
-		if (valStatus==CAPE_NOT_VALIDATED)
-		 {SetError(L"Unit has not been validated",L"ICapeUnit",L"Calculate");
-	   	  return ECapeUnknownHR;
-		 }
-		ATLASSERT(valStatus==CAPE_VALID);
 		//init variables
 		componentFlows.resize(nCompounds);
 		for (j=0;j<nCompounds;j++) componentFlows[j]=0;
 		totalFlow=0; 
 		enthalpy=0;
 		pressure=0;
-		//loop over the connected feed ports, get the minimum pressure and the total component and enthalpy flows
+		//for the calculations we need to know the heat input or the outlet temperature, and the split factor
+		double splitFactor;
+		double heatInput;
+		double heatDuty; //[J/s]
+		bool temperatureSpecified;
+		splitFactor=GetParameterValue(0); //split factor
+		temperatureSpecified=(GetParameterValue(5)!=0); //specification
+		heatInput=(temperatureSpecified)?0:GetParameterValue(1); //heat input, calculated if the outlet temperature is specified
+		heatDuty=heatInput;
+		//calculate the contributions of the connected feed ports; optionally these are calculated concurrently
+		control.SetProgress(10,L"Calculating feeds");
+		FeedContribution feeds[2];
+		FeedContribution *connectedFeeds[2];
+		int nConnectedFeeds=0;
 		for (i=0;i<2;i++)
-		   {port=(MaterialPortObject *)portCollection->items[i];
+		   {port=(MaterialPortObject *)GetPortCollection()->items[i];
 			if (port->IsConnected())
-			   {//get the pressure
-				material=port->GetMaterial();
-				if (!material.GetOverallProperty(L"pressure",NULL,value,error))
-				   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-					return ECapeUnknownHR;
-				   }
-				//check count
-				if (value.GetCount()!=1)
-				   {SetError(L"Invalid values for pressure from material object: scalar expected",L"ICapeUnit",L"Calculate");
-					return ECapeUnknownHR;
-				   }
-				//use minimum pressure
-				d=value.GetDoubleAt(0);
-				if ((pressure==0)||(d<pressure)) pressure=d;
-				//get total flow
-				if (!material.GetOverallProperty(L"totalFlow",L"mole",value,error))
-				   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-					return ECapeUnknownHR;
-				   }
-				//check count
-				if (value.GetCount()!=1)
-				   {SetError(L"Invalid values for total flow from material object: scalar expected",L"ICapeUnit",L"Calculate");
-					return ECapeUnknownHR;
-				   }
-				flow=value.GetDoubleAt(0); //flow of this feed
-				if (flow>0)
-				   {//add to total flow
-					totalFlow+=flow;
-					//get the composition
-					if (!material.GetOverallProperty(L"fraction",L"mole",value,error))
-					   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//check count 
-					if (value.GetCount()!=nCompounds)
-					   {SetError(L"Invalid values for overall fraction from material object: unexpected number of values",L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//add to component flows
-					for (j=0;j<nCompounds;j++) componentFlows[j]+=flow*value.GetDoubleAt(j); // [mol/s] += [mol/s]*[mol/mol]
-					//calculate enthalpy contributions of present phases on duplicate material object
-					// (we are not allowed to change the status of material objects connected to the feed, this includes performing property calculations)
-					if (!material.Duplicate(duplicateMaterial,error))
-					   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//get the list of present phases
-					if (!duplicateMaterial.GetListOfPresentPhases(phaseList,error))
-					   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//loop over all phases to get phase contribution of enthalpy
-					for (k=0;k<phaseList.GetCount();k++)
-					   {CBSTR phaseName=phaseList.GetStringAt(k);
-						//get the phase fraction for this phase
-						if (!duplicateMaterial.GetSinglePhaseProperty(L"phaseFraction",phaseName,NULL,L"mole",value,error))
-						   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-							return ECapeUnknownHR;
-						   }
-						//check count 
-						if (value.GetCount()!=1)
-						   {SetError(L"Invalid values for phase fraction from material object: scalar expected",L"ICapeUnit",L"Calculate");
-							return ECapeUnknownHR;
-						   }
-						phaseFraction=value.GetDoubleAt(0);
-						if (phaseFraction>0)
-						   {//calculate enthalpy for this phase
-							if (!duplicateMaterial.CalcSinglePhaseProperty(L"enthalpy",phaseName,error))
-							   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-								return ECapeUnknownHR;
-							   }
-							//get the value of enthalpy
-							if (!duplicateMaterial.GetSinglePhaseProperty(L"enthalpy",phaseName,L"mixture",L"mole",value,error))
-							   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-								return ECapeUnknownHR;
-							   }
-							//check count 
-							if (value.GetCount()!=1)
-							   {SetError(L"Invalid values for enthalpy from material object: scalar expected",L"ICapeUnit",L"Calculate");
-								return ECapeUnknownHR;
-							   }
-							//add contribution to total enthalpy
-							enthalpy+=flow*phaseFraction*value.GetDoubleAt(0); // [J/s]+=[mol/s]*[mol/mol]*[J/mol]
-						   }
-					   }
+			   {port->GetMaterial(feeds[i].material);
+				port->GetFeedCache(feeds[i].cache);
+				connectedFeeds[nConnectedFeeds++]=&feeds[i];
+			   }
+		   }
+		//without heat input, if all feeds with flow are in the same state (temperature, pressure and present phases) and
+		// have the same composition, the product is in that state as well, and neither the enthalpy of the feeds nor the 
+		// PH flash is needed. Feeds of different composition at the same temperature need the PH flash, as the enthalpy 
+		// of mixing changes the product temperature and phase split
+		bool sameState=false,sameComposition=false;
+		FeedContribution *reference=NULL; //first feed with flow
+		bool parallelFeeds=(GetParameterValue(2)!=0); //parallel feeds
+		if ((heatInput==0)&&(!temperatureSpecified))
+		   {//read the feed states, concurrently if so requested; the feed stage does not read them again
+			FeedStage readStage(connectedFeeds,nConnectedFeeds,nCompounds,&control);
+			readStage.Run<W>(parallelFeeds,true);
+			sameState=true;
+			sameComposition=true;
+			for (k=0;k<nConnectedFeeds;k++)
+			   {FeedContribution *feed=connectedFeeds[k];
+				if (!feed->stateRead) return CalculationError(control,feed->error);
+				if (feed->flow>0)
+				   {bool same;
+					if (!reference) reference=feed;
+					else if (!reference->SameState(*feed,nCompounds,same)) sameState=false;
+					else if (!same) sameComposition=false;
 				   }
 			   }
+			//feeds without flow do not affect the state, except for the product pressure, which is the minimum feed pressure
+			if (reference)
+			   {for (k=0;k<nConnectedFeeds;k++)
+				   if (connectedFeeds[k]->pressure<reference->pressure*(1-IDENTICALSTATETOLERANCE)) sameState=false;
+			   }
+			else sameState=false; //zero total flow
+			if (!sameState) sameComposition=false;
+		   }
+		if (!sameComposition)
+		   {FeedStage feedStage(connectedFeeds,nConnectedFeeds,nCompounds,&control);
+			feedStage.Run<W>(parallelFeeds);
+			//keep the cached feed enthalpies for the next calculation
+			for (i=0;i<2;i++)
+			   if (feeds[i].ok) ((MaterialPortObject *)GetPortCollection()->items[i])->SetFeedCache(feeds[i].cache);
+		   }
+		//get the minimum pressure and the total component and enthalpy flows, in port order
+		FeedContribution *lastFlowingFeed=NULL;
+		for (k=0;k<nConnectedFeeds;k++)
+		   {FeedContribution *feed=connectedFeeds[k];
+			if ((!sameComposition)&&(!feed->ok)) return CalculationError(control,feed->error);
+			//use minimum pressure
+			if ((pressure==0)||(feed->pressure<pressure)) pressure=feed->pressure;
+			if (feed->flow>0)
+			   {//add to total flow, component flows and enthalpy
+				totalFlow+=feed->flow;
+				for (j=0;j<nCompounds;j++) componentFlows[j]+=feed->componentFlows[j];
+				enthalpy+=feed->enthalpy;
+				//the last duplicate material is used for the PH flash
+				if (feed->duplicateMaterial.IsValid()) duplicateMaterial=feed->duplicateMaterial;
+				lastFlowingFeed=feed;
+			   }
+		   }
+		if ((totalFlow>0)&&(!sameComposition)&&(!duplicateMaterial.IsValid()))
+		   {//the enthalpy of all feeds was taken from the feed materials; we still need a duplicate for the product
+			if (!lastFlowingFeed->material.Duplicate(duplicateMaterial,error)) return CalculationError(control,error);
 		   }
-		//we have the feed values, for the remainder of the calculations we need to know the heat input and the split factor
-		double splitFactor;
-		double heatInput;
-		RealParameterObject *par;
-		par=(RealParameterObject *)parameterCollection->items[0]; //split factor
-		splitFactor=par->value;
-		par=(RealParameterObject *)parameterCollection->items[1]; //heat input
-		heatInput=par->value;
 		//calculate the product composition and temperature
+		control.SetProgress(50,L"Calculating product temperature");
+		if (!control.Continue(error)) return CalculationError(control,error);
 		CVariant composition; //[mol/mol]
 		composition.MakeArray(nCompounds,VT_R8);
+		bool equilibrium=false; //set if the duplicate material is at equilibrium at the product state
 		if (totalFlow==0)
 		   {//we can fail the calculation at this point. It is however best if we can produce an answer that will satisfy the mass
 			// and energy balance. The mass balance is satisfied with all zero product flows, at any composition and temperature. The 
@@ -319,41 +513,28 @@ public:
 			   {SetError(L"Total flow is zero. Cannot satisfy energy balance with non-zero heat input",L"ICapeUnit",L"Calculate");
 				return ECapeUnknownHR;
 			   }
-			//take temperature as the average feed temperature, take composition as average feed composition
+			//take temperature as the average feed temperature, take composition as average feed composition; these
+			// are not read by the feed stage for feeds without flow
+			CVariant value;
 			d=0;
 			temperature=0;
 			for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,0);
-			for (i=0;i<2;i++)
-			   {port=(MaterialPortObject *)portCollection->items[i];
-				if (port->IsConnected())
-				   {//add to division
-					d+=1.0;
-					//get the temperature
-					material=port->GetMaterial();
-					if (!material.GetOverallProperty(L"temperature",NULL,value,error))
-					   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//check count
-					if (value.GetCount()!=1)
-					   {SetError(L"Invalid values for temperature from material object: scalar expected",L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//add 
-					temperature+=value.GetDoubleAt(0);
-					//get the composition
-					if (!material.GetOverallProperty(L"fraction",L"mole",value,error))
-					   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//check count
-					if (value.GetCount()!=nCompounds)
-					   {SetError(L"Invalid values for overall fraction from material object: unexpected number of values",L"ICapeUnit",L"Calculate");
-						return ECapeUnknownHR;
-					   }
-					//add
-					for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,composition.GetDoubleAt(j)+value.GetDoubleAt(j));
-				   }
+			for (k=0;k<nConnectedFeeds;k++)
+			   {MaterialAccess<W> feed(connectedFeeds[k]->material);
+				//add to division
+				d+=1.0;
+				//get the temperature
+				if (!feed.GetOverallProperty(PROPERTY_TEMPERATURE,BASIS_UNDEFINED,value,error)) return CalculationError(control,error);
+				//check count
+				if (value.GetCount()!=1) return CalculationError(control,L"Invalid values for temperature from material object: scalar expected");
+				//add 
+				temperature+=value.GetDoubleAt(0);
+				//get the composition
+				if (!feed.GetOverallProperty(PROPERTY_FRACTION,BASIS_MOLE,value,error)) return CalculationError(control,error);
+				//check count
+				if (value.GetCount()!=nCompounds) return CalculationError(control,L"Invalid values for overall fraction from material object: unexpected number of values");
+				//add
+				for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,composition.GetDoubleAt(j)+value.GetDoubleAt(j));
 			   }
 			//divide by d, if not unity
 			if (d!=1.0)
@@ -362,6 +543,27 @@ public:
 				for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,composition.GetDoubleAt(j)*d);
 				temperature*=d;
 			   }
+			//the energy balance is satisfied at any temperature
+			if (temperatureSpecified) temperature=GetParameterValue(6); //outlet temperature
+		   }
+		else if (temperatureSpecified)
+		   {//we have a non-zero total flow and a specified outlet temperature; calculate composition
+			for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,componentFlows[j]/totalFlow); //[mol/mol]=[mol/s]/[mol/s]
+			temperature=GetParameterValue(6); //outlet temperature
+			//the heat duty follows from the enthalpy of the product, obtained from a TP flash on the duplicate 
+			// material, and the enthalpy of the feeds; this replaces the PH flash
+			double molarEnthalpy; //[J/mol]
+			MaterialAccess<W> duplicate(duplicateMaterial);
+			if (!duplicate.SetFromFlowTPX(composition,totalFlow,temperature,pressure,error)) return CalculationError(control,error);
+			equilibrium=true;
+			if (!FeedContribution::MolarEnthalpy(duplicate,&control,molarEnthalpy,error)) return CalculationError(control,error);
+			heatDuty=totalFlow*molarEnthalpy-enthalpy; //[J/s]=[mol/s]*[J/mol]-[J/s]
+		   }
+		else if (sameComposition)
+		   {//we have a non-zero total flow of feeds of the same composition in the same state, without heat input
+			for (j=0;j<nCompounds;j++) composition.SetDoubleAt(j,componentFlows[j]/totalFlow); //[mol/mol]=[mol/s]/[mol/s]
+			//the product is at the temperature of the feeds
+			temperature=reference->temperature;
 		   }
 		else
 		   {//we have a non-zero total flow; calculate composition
@@ -372,24 +574,89 @@ public:
 			double molarEnthalpy=enthalpy/totalFlow; //[J/mol]=[J/s]/[mol/s]
 			//we perform this calculation on a duplicate material. In case of non-zero flow, the duplicate material 
 			// should still be set from the enthalpy calculations
-			ATLASSERT(duplicateMaterial.IsValid());
-			//we can use this material:
-			if (!duplicateMaterial.GetTemperatureFromPHFlash(composition,pressure,molarEnthalpy,temperature,error))
-			   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-				return ECapeUnknownHR;
+			MaterialAccess<W> duplicate(duplicateMaterial);
+			//the flash may have been calculated before: the last converged solution of this unit operation may hold 
+			// the answer, or the flash cache, for a result of this or another process; close to the state of the last
+			// PH flash, the temperature is extrapolated with the heat capacity. Otherwise the last converged solution
+			// serves as initial estimate for the PH flash
+			ThermoMetadata *md=duplicateMaterial.GetMetadata();
+			ULONGLONG identity=(md)?md->identity:0; //identity of the compounds and phases of the property package
+			ULONGLONG fingerprint=ConvergedState::Fingerprint(pressure,molarEnthalpy,composition);
+			ULONG cacheTag=(ULONG)GetParameterValue(10); //flash cache tag, zero if not used; an integer after validation
+			bool flashCache=((cacheTag!=0)&&(md));
+			double maxDeltaH=GetParameterValue(9); //linearization limit
+			double linearizationError; //[K]
+			bool solved=false,linearized=false,converged=false,cached=false;
+			Lock();
+			ConvergedState previous=convergedState;
+			Unlock();
+			if (previous.Matches(identity,fingerprint,pressure,composition))
+			   {temperature=previous.temperature;
+				solved=converged=true;
+			   }
+			if ((!solved)&&(flashCache)) solved=cached=FlashCache::Find(cacheTag,identity,pressure,molarEnthalpy,composition,temperature);
+			if ((!solved)&&(maxDeltaH>0))
+			   {Lock();
+				linearized=linearizedState.Extrapolate(pressure,molarEnthalpy,composition,maxDeltaH,temperature,linearizationError);
+				Unlock();
+				solved=linearized;
+			   }
+			if (solved)
+			   {//set the duplicate material by a TP flash at the temperature; for an extrapolated temperature, this 
+				// confirms that the product is in the same phase region
+				if (!duplicate.SetFromFlowTPX(composition,totalFlow,temperature,pressure,error)) return CalculationError(control,error);
+				if ((converged)||(cached))
+				   {//the identity does not distinguish property packages with the same compounds and phases; a stored
+					// temperature applies if the enthalpy at that temperature is the flash enthalpy
+					double storedEnthalpy; //[J/mol]
+					if (!FeedContribution::MolarEnthalpy(duplicate,&control,storedEnthalpy,error)) return CalculationError(control,error);
+					solved=(fabs(storedEnthalpy-molarEnthalpy)<=((cached)?FLASHCACHEENTHALPYTOLERANCE:CONVERGEDSTATEENTHALPYTOLERANCE));
+					if ((!solved)&&(cached)) FlashCache::Reject();
+				   }
+				if (linearized)
+				   {CVariant phaseList;
+					if (!duplicate.GetListOfPresentPhases(phaseList,error)) return CalculationError(control,error);
+					Lock();
+					solved=linearizedState.SamePhases(phaseList);
+					if (solved)
+					   {linearizedCalculations++;
+						linearizationErrorEstimate=linearizationError;
+					   }
+					Unlock();
+				   }
+			   }
+			if (!solved)
+			   {//not stored, phase boundary crossed, or not close to the last PH flash
+				const ConvergedState *estimate=NULL;
+				if ((previous.valid)&&(previous.identity==identity)&&((int)previous.composition.size()==nCompounds)) estimate=&previous;
+				//we can use this material:
+				if (!duplicate.GetTemperatureFromPHFlash(composition,pressure,molarEnthalpy,temperature,error,estimate)) return CalculationError(control,error);
+				//store the converged solution
+				CVariant phaseList;
+				if (!duplicate.GetListOfPresentPhases(phaseList,error)) return CalculationError(control,error);
+				Lock();
+				if (convergedState.Set(identity,fingerprint,temperature,pressure,composition,phaseList)) dirty=true; //the converged solution is saved
+				linearizedState.Set(temperature,pressure,molarEnthalpy,composition,phaseList);
+				Unlock();
+				if (flashCache) FlashCache::Store(cacheTag,identity,pressure,molarEnthalpy,composition,temperature);
 			   }
+			equilibrium=true;
 		   }
 		//set the output values; the split factor applies only in case there are two connected product ports. Count them
 		int numberOfConnectedProductPorts=0;
 		for (i=2;i<4;i++)
-		   {port=(MaterialPortObject *)portCollection->items[i];
+		   {port=(MaterialPortObject *)GetPortCollection()->items[i];
 			if (port->IsConnected()) numberOfConnectedProductPorts++;
 		   }
-		//loop over the connected outlet ports to set the result
+		//loop over the connected outlet ports to set the result; products that did not change are not 
+		// written, so that the simulation environment can skip the calculation of downstream units
+		double outputTolerance=GetParameterValue(8); //output tolerance
+		bool changed=false;
 		for (i=2;i<4;i++)
-		   {port=(MaterialPortObject *)portCollection->items[i];
+		   {port=(MaterialPortObject *)GetPortCollection()->items[i];
 			if (port->IsConnected())
-			   {material=port->GetMaterial();
+			   {control.SetProgress(75,L"Calculating products");
+				if (!control.Continue(error)) return CalculationError(control,error);
 				//calc total flow for this stream 
 				if (numberOfConnectedProductPorts==2)
 				   {//use splitFactor for stream 2, 1-splitFactor for stream 3
@@ -400,14 +667,38 @@ public:
 				   {//use totalFlow
 					flow=totalFlow;
 				   }
-				//set from composition, T and P and perform a flash
-				if (!material.SetFromFlowTPX(composition,flow,temperature,pressure,error))
-				   {SetError(error.c_str(),L"ICapeUnit",L"Calculate");
-					return ECapeUnknownHR;
+				if (port->IsWritten(composition,flow,temperature,pressure,outputTolerance)) continue; //unchanged
+				port->GetMaterial(material);
+				MaterialAccess<W> product(material);
+				if (port->IsWrittenState(composition,temperature,pressure,outputTolerance))
+				   {//only the flow changed; the phase equilibrium does not depend on the flow, so no flash is needed
+					if (product.SetTotalFlow(flow))
+					   {port->SetWrittenFlow(flow);
+						changed=true;
+						continue;
+					   }
+				   }
+				port->SetWritten(NULL); //in case of failure, the content of the material object is unknown
+				//copy from the duplicate material if that is at equilibrium at the product state, so that no flash is needed
+				if ((!equilibrium)||(!product.CopyFrom(duplicateMaterial,flow)))
+				   {//not supported by the material object, do not try again for the other product
+					equilibrium=false;
+					//set from composition, T and P and perform a flash
+					if (!product.SetFromFlowTPX(composition,flow,temperature,pressure,error)) return CalculationError(control,error);
 				   }
+				port->SetWritten(&composition,flow,temperature,pressure);
+				changed=true;
 			   }
 		   }
+		Lock();
+		outputsChanged=changed;
+		if (changed) changedCalculations++;
+		else unchangedCalculations++;
+		Unlock();
+		//report the heat duty
+		((RealParameterObject *)GetParameterCollection()->items[7])->SetValue(heatDuty);
 		//all ok
+		control.SetProgress(100,L"Calculation finished");
 		return NOERROR;
 	}
 
@@ -424,6 +715,10 @@ public:
 	produce an error return just because the unit is not valid.
 
 	Validate must also update the validation status.
+
+	The metadata of the property package on each port is obtained from the process-wide
+	ThermoMetadataCache, so that unit operations sharing a property package do not each
+	query it; the ports keep the metadata for use during calculation.
 	\param message [in, out] textual description of reason for not being valid, if isValid is VARIANT_FALSE
 	\param isValid [out, retval]
 	\sa Calculate(), get_ValStatus()
@@ -431,6 +726,12 @@ public:
 
 	STDMETHOD(Validate)(BSTR * message, VARIANT_BOOL * isValid)
 	{	if ((!message)||(!isValid)) return E_POINTER; //invalid pointer
+		CComCritSecLock<CComAutoCriticalSection> calculating(calculationLock);
+		if (activeControl)
+		   {//called while the simulation environment processes a progress message
+			SetError(L"Cannot validate while a calculation is in progress",L"ICapeUnit",L"Validate");
+			return ECapeBadInvOrderHR;
+		   }
 		//assume innocent, until proven guilty
 		*isValid=VARIANT_TRUE;
 		//note that message is marked [in, out]; this implies if we put something in it, we should free whatever is in it already. Let us do that now
@@ -440,15 +741,16 @@ public:
 			*message=NULL;
 		}
 		//we need at least one connected feed and one connected product
-		unsigned int i,j;
-		int k;
+		unsigned int i;
+		int compoundCount=0;
 		wstring error,portName1;
 		MaterialPortObject *port;
 		bool haveConnectedFeed=false,haveConnectedProduct=false;
-		CVariant compList1,compList2;
+		ThermoMetadata *metadata,*firstMetadata=NULL;
+		int version=0;
 		Material material;
-		for (i=0;i<portCollection->items.size();i++)
-		   {port=(MaterialPortObject*)portCollection->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
+		for (i=0;i<GetPortCollection()->items.size();i++)
+		   {port=(MaterialPortObject*)GetPortCollection()->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
 			if (port->IsConnected())
 			   {if (i<2) 
 				   {//this is a feed
@@ -457,6 +759,9 @@ public:
 				else
 				   {//this is a product
 					haveConnectedProduct=true;
+					//validation follows a change to the flowsheet; the simulation environment may have reset or reused the
+					// material object since we last wrote it, so the next calculation writes the product in full
+					port->SetWritten(NULL);
 				   }
 			   }
 		   }
@@ -468,94 +773,79 @@ public:
 		   {*message=SysAllocString(L"At least one product port must be connected.");
 			*isValid=VARIANT_FALSE;
 		   }
+		else if ((double)(ULONG)GetParameterValue(10)!=GetParameterValue(10))
+		   {//the tag names the cache file; a fractional tag would share the file of its integer part
+			*message=SysAllocString(L"Flash cache tag must be an integer.");
+			*isValid=VARIANT_FALSE;
+		   }
 		if (*isValid)
-		   {//let us verify that the list of compounds on each port is the same; find the first connected port
-			for (i=0;i<portCollection->items.size();i++)
-			   {port=(MaterialPortObject*)portCollection->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
+		   {//get the metadata of the property package on each port from the shared cache, and verify that 
+			// the list of compounds on each port is the same. The ports keep the metadata for calculations
+			for (i=0;i<GetPortCollection()->items.size();i++)
+			   {port=(MaterialPortObject*)GetPortCollection()->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
 				if (port->IsConnected())
 				   {//get a material from this port
-					material=port->GetMaterial();
-					if (!material.GetCompoundIDs(compList1,error))
+					port->GetMaterial(material);
+					metadata=ThermoMetadataCache::Acquire(material,error);
+					if (!metadata)
 					   {*message=SysAllocString(error.c_str());
 						*isValid=VARIANT_FALSE;
 						break; //break out of loop i
 					   }
-					//store port name in case of error
-					portName1=port->name;
-					//store the number of compounds for calculation
-					nCompounds=compList1.GetCount();
-					//loop over all the other ports to compare the list 
-					for (j=i+1;j<portCollection->items.size();j++)
-					   {port=(MaterialPortObject*)portCollection->items[j]; //item is stored as CAPEOPENBaseObject, cast to port
-						if (port->IsConnected())
-						   {material=port->GetMaterial();
-							if (!material.GetCompoundIDs(compList2,error))
-							   {*message=SysAllocString(error.c_str());
-								*isValid=VARIANT_FALSE;
-								break; //break out of loop j
-							   }
-							//check same
-							bool same=true; 
-							if (compList1.GetCount()!=compList2.GetCount()) same=false;
-							else
-							   {//check each compound
-								for (k=0;k<compList1.GetCount();k++)
-								   {CBSTR comp1=compList1.GetStringAt(k);
-									CBSTR comp2=compList2.GetStringAt(k);
-									if (!CBSTR::Same(comp1,comp2))
-									   {same=false;
-										break;
-									   }
-								   }
-							   }
-							if (!same)
-							   {//invalid
-								error=L"Compound list on material connected to port ";
-								error+=portName1;
-								error+=L" is not the same as compound list on material connected to port ";
-								error+=port->name;
-								error+=L'.';
-								*message=SysAllocString(error.c_str());
-								*isValid=VARIANT_FALSE;
-								break; //break out of loop j
-							   }
-						   }
+					port->SetMetadata(metadata);
+					if (!firstMetadata)
+					   {//first connected port; store port name in case of error
+						firstMetadata=metadata;
+						portName1=port->GetName(); //ports cannot be renamed
+						//store the number of compounds and the thermo version for calculation
+						compoundCount=firstMetadata->compoundIDs.GetCount();
+						version=firstMetadata->thermoVersion;
+						continue; //keep our reference
+					   }
+					//calculations on material objects of different versions use virtual calls
+					if (metadata->thermoVersion!=version) version=0;
+					//check same compounds as on first port
+					bool same=firstMetadata->SameCompounds(metadata);
+					metadata->Release(); //port holds a reference
+					if (!same)
+					   {//invalid
+						error=L"Compound list on material connected to port ";
+						error+=portName1;
+						error+=L" is not the same as compound list on material connected to port ";
+						error+=port->GetName();
+						error+=L'.';
+						*message=SysAllocString(error.c_str());
+						*isValid=VARIANT_FALSE;
+						break; //break out of loop i
 					   }
-					break; //break out of loop i
 				   }
 			   }
 		   }
 		if (*isValid)
 		   {//this unit needs enthalpy, see if it is available. Get from first connected port
-			for (i=0;i<portCollection->items.size();i++)
-			   {port=(MaterialPortObject*)portCollection->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
-				if (port->IsConnected())
-				   {//get a material from this port
-					material=port->GetMaterial();
-					CVariant propList;
-					if (!material.GetSinglePhasePropList(propList,error))
-					   {//failed to get the prop list
-						*message=SysAllocString(error.c_str());
-						*isValid=VARIANT_FALSE;
-					   }
-					else
-					   {//check that enthalpy is in there:
-						for (k=0;k<propList.GetCount();k++)
-						   {CBSTR prop=propList.GetStringAt(k);
-							if (CBSTR::Same(prop,L"enthalpy")) break; //comparison is case-insensitive
-						   }
-						if (k==propList.GetCount())
-						   {//enthalpy is not available (or at least not in this list)
-							*message=SysAllocString(L"Property Enthalpy is not available. Enthalpy is required by this unit operation.");
-							*isValid=VARIANT_FALSE;
-						   }
-					   }
-					break;
-				   }
+			ATLASSERT(firstMetadata);
+			if (!firstMetadata->enthalpyAvailable)
+			   {//enthalpy is not available (or at least not in this list)
+				*message=SysAllocString(L"Property Enthalpy is not available. Enthalpy is required by this unit operation.");
+				*isValid=VARIANT_FALSE;
 			   }
 		   } 
-		//update the validation status:
-		valStatus=(*isValid)?CAPE_VALID:CAPE_INVALID;
+		//the last converged solution and the heat capacity only apply to the property package that produced them;
+		// the first connected port is a feed, the product flash uses a feed material
+		ULONGLONG identity=(firstMetadata)?firstMetadata->identity:0;
+		if (firstMetadata) firstMetadata->Release();
+		//update the validation status and the number of compounds used by Calculate:
+		Lock();
+		if ((*isValid)&&(convergedState.identity!=identity))
+		   {if (convergedState.valid) dirty=true; //the saved solution is removed
+			convergedState=ConvergedState();
+			convergedState.identity=identity;
+			linearizedState=LinearizedState();
+		   }
+		nCompounds=compoundCount;
+		thermoVersion=version;
+		InterlockedExchange((volatile LONG*)&valStatus,(LONG)((*isValid)?CAPE_VALID:CAPE_INVALID));
+		Unlock();
 		return NOERROR;
 	}
 
@@ -570,8 +860,9 @@ public:
 	STDMETHOD(get_parameters)(LPDISPATCH * parameters)
 	{	if (!parameters) return E_POINTER; //invalid pointer
 		//instead of doing this, we can also call QueryInterface on the parameter collection
-		*parameters=(ICapeCollection*)parameterCollection;
-		parameterCollection->AddRef(); //the caller must release this object
+		CollectionObject *collection=GetParameterCollection();
+		*parameters=(ICapeCollection*)collection;
+		collection->AddRef(); //the caller must release this object
 		//all done
 		return NOERROR;
 	}
@@ -585,7 +876,8 @@ public:
 	*/
 
 	STDMETHOD(put_simulationContext)(LPDISPATCH simContext)
-	{	//release old simulation context
+	{	ObjectLock lock(this);
+		//release old simulation context
 		if (simulationContext)
 		   {simulationContext->Release();
 			simulationContext=NULL;
@@ -621,15 +913,21 @@ public:
 
 	STDMETHOD(Terminate)()
 	{	unsigned int i;
+		//stop a calculation that may be in progress
+		CancelCalculation();
 		//release the simulation context, if any
+		Lock();
 		if (simulationContext) 
 		   {simulationContext->Release();
 			simulationContext=NULL;
 		   }
-		//disconnect the ports
-		for (i=0;i<portCollection->items.size();i++)
-		   {MaterialPortObject *port=(MaterialPortObject *)portCollection->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
-			port->Disconnect();
+		Unlock();
+		//disconnect the ports, if created
+		if (portCollection)
+		   {for (i=0;i<portCollection->items.size();i++)
+			   {MaterialPortObject *port=(MaterialPortObject *)portCollection->items[i]; //item is stored as CAPEOPENBaseObject, cast to port
+				port->Disconnect();
+			   }
 		   }
 		return NOERROR;
 	}
@@ -644,14 +942,19 @@ public:
 	STDMETHOD(Edit)()
 	{	//get references to parameters that we are editing
 		RealParameterObject *splitFactor,*heatInput;
-		splitFactor=(RealParameterObject *)parameterCollection->items[0];
-		heatInput=(RealParameterObject *)parameterCollection->items[1];
+		splitFactor=(RealParameterObject *)GetParameterCollection()->items[0];
+		heatInput=(RealParameterObject *)GetParameterCollection()->items[1];
+		//edit copies of the values; the parameters may be accessed by other threads while the dialog is shown
+		double splitFactorValue=splitFactor->GetValue();
+		double heatInputValue=heatInput->GetValue();
 		//create edit dialog
-		CEditDialog *dlg=new CEditDialog(&splitFactor->value,&heatInput->value);
+		CEditDialog *dlg=new CEditDialog(&splitFactorValue,&heatInputValue);
 		dlg->DoModal();
 		delete dlg;
+		splitFactor->SetValue(splitFactorValue);
+		heatInput->SetValue(heatInputValue);
 		//we are no longer in a validated state
-		valStatus=CAPE_NOT_VALIDATED;
+		InterlockedExchange((volatile LONG*)&valStatus,(LONG)CAPE_NOT_VALIDATED);
 		dirty=true; //we need to be saved
 		return NOERROR;
 	}
@@ -667,11 +970,14 @@ public:
 	STDMETHOD(IsDirty)()
 	{//we are dirty if the parameters are dirty as well
 		unsigned int i;
-		for (i=0;i<parameterCollection->items.size();i++)
-		   {RealParameterObject *par=(RealParameterObject *)parameterCollection->items[i];
-			if (par->dirty) 
-			   {dirty=true;
-				break;
+		CollectionObject *collection=parameterCollection; //parameters that have not been created are not dirty
+		if (collection)
+		   {for (i=0;i<collection->items.size();i++)
+			   {RealParameterObject *par=(RealParameterObject *)collection->items[i];
+				if (par->dirty) 
+				   {dirty=true;
+					break;
+				   }
 			   }
 		   }
 		return (dirty)?S_OK:S_FALSE;
@@ -679,34 +985,94 @@ public:
 
 	//! IPersistStream::Load
 	/*!
-	Restore from persistence
+	Restore from persistence. From version 3, the file consists of the version number, the 
+	size of the remainder of the data and the remainder of the data; the remainder is read 
+	by a single call into the persistence buffer and then parsed. Files of earlier versions
+	are read by LoadVersion2(). From version 4, the last converged solution includes the
+	identity of the property package.
 	\param pstm [in] IStream to load from
 	\return S_OK for success, or S_FALSE
-	\sa Save()
+	\sa Save(), LoadVersion2()
 	*/
 
 	STDMETHOD(Load)(IStream * pstm)
 	{   if (!pstm) return E_POINTER;
+		UINT header[2]; //version number and data size; before version 3, the length of the name follows the version number
 		UINT fileVersion;
 		unsigned int i;
 		RealParameterObject *par;
 		ULONG read;
-		UINT length;
-		OLECHAR *buf;
-		if (FAILED(pstm->Read(&fileVersion,sizeof(UINT),&read))) return E_FAIL; //this is not a CAPE-OPEN function, we do not return a CAPE-OPEN error
-		if (read!=sizeof(UINT)) return E_FAIL;
+		UINT parameterCount;
+		wstring newName,newDescription;
+		vector<double> values;
+		ConvergedState state;
+		//all files contain at least two UINT values
+		if (FAILED(pstm->Read(header,sizeof(header),&read))) return E_FAIL; //this is not a CAPE-OPEN function, we do not return a CAPE-OPEN error
+		if (read!=sizeof(header)) return E_FAIL;
+		fileVersion=header[0];
 		if (fileVersion>CURRENTFILEVERSIONNUMBER)
 		   {//popping up messages is in general not a good idea; however, this one is a rather important one, so we make an exception here:
 			MessageBox(NULL,L"This unit operation was saved with a newer version of the software. Please obtain the latest CPP Mixer Splitter Example from the CO-LaN web site",L"Error loading:",MB_ICONHAND);
 			return E_FAIL;
 		   }
+		if (fileVersion<3) return LoadVersion2(pstm,fileVersion,header[1]);
+		if (header[1]>MAXPERSISTSIZE) return E_FAIL; //not a valid file
+		//the buffer is shared by Load and Save
+		ObjectLock lock(this);
+		//read all data at once
+		persistBuffer.Reset(header[1]);
+		if (header[1])
+		   {if (FAILED(pstm->Read(persistBuffer.GetData(),header[1],&read))) return E_FAIL;
+			if (read!=header[1]) return E_FAIL;
+		   }
+		//parse; nothing is changed unless all data is valid
+		if (!persistBuffer.GetString(newName)) return E_FAIL;
+		if (!persistBuffer.GetString(newDescription)) return E_FAIL;
+		if (!persistBuffer.GetUINT(parameterCount)) return E_FAIL;
+		if (parameterCount>persistBuffer.Remaining()/sizeof(double)) return E_FAIL;
+		values.resize(parameterCount);
+		for (i=0;i<parameterCount;i++)
+		   {if (!persistBuffer.GetDouble(values[i])) return E_FAIL;
+		   }
+		if (!state.Load(persistBuffer,fileVersion)) return E_FAIL;
+		//apply; parameters we do not know about are skipped
+		SetName(newName.c_str());
+		SetDescription(newDescription.c_str());
+		CollectionObject *collection=GetParameterCollection();
+		for (i=0;(i<parameterCount)&&(i<collection->items.size());i++)
+		   {par=(RealParameterObject *)collection->items[i];
+			par->SetValue(values[i]);
+		   }
+		convergedState=state;
+		linearizedState=LinearizedState(); //the heat capacity applies to the previous flowsheet
+		//all ok 
+		return S_OK;
+	}
+
+	//! Load a file of version 2 or earlier
+	/*!
+	Restore from persistence, for files before version 3. These are read field by field. 
+	\param pstm [in] IStream to load from
+	\param fileVersion the version number of the file, already read
+	\param length the length of the name, already read
+	\return S_OK for success, or S_FALSE
+	\sa Load()
+	*/
+
+	HRESULT LoadVersion2(IStream * pstm,UINT fileVersion,UINT length)
+	{	unsigned int i;
+		RealParameterObject *par;
+		ULONG read;
+		UINT parameterCount;
+		OLECHAR *buf;
+		double value;
 		//read name
-		if (FAILED(pstm->Read(&length,sizeof(UINT),&read))) return E_FAIL; 
-		if (read!=sizeof(UINT)) return E_FAIL;
 		buf=new OLECHAR[length+1]; //space for terminating zero
 		if (FAILED(pstm->Read(buf,2*(length+1),&read))) {delete []buf;return E_FAIL;}
 		if (read!=2*(length+1)) {delete []buf;return E_FAIL;}
-		name=buf;
+		Lock();
+		SetName(buf);
+		Unlock();
 		delete []buf;
 		//read description
 		if (FAILED(pstm->Read(&length,sizeof(UINT),&read))) return E_FAIL; 
@@ -714,21 +1080,42 @@ public:
 		buf=new OLECHAR[length+1]; //space for terminating zero
 		if (FAILED(pstm->Read(buf,2*(length+1),&read))) {delete []buf;return E_FAIL;}
 		if (read!=2*(length+1)) {delete []buf;return E_FAIL;}
-		description=buf;
+		Lock();
+		SetDescription(buf);
+		Unlock();
 		delete []buf;
-		//read parameter values
-		for (i=0;i<2;i++)
-		   {par=(RealParameterObject *)parameterCollection->items[i];
-			if (FAILED(pstm->Read(&par->value,sizeof(double),&read))) return E_FAIL; 
+		//read parameter count; version 0 files contain the split factor and heat input only
+		if (fileVersion==0) parameterCount=2;
+		else
+		   {if (FAILED(pstm->Read(&parameterCount,sizeof(UINT),&read))) return E_FAIL; 
+			if (read!=sizeof(UINT)) return E_FAIL;
+		   }
+		//read parameter values; parameters we do not know about are skipped
+		CollectionObject *collection=GetParameterCollection();
+		for (i=0;i<parameterCount;i++)
+		   {if (FAILED(pstm->Read(&value,sizeof(double),&read))) return E_FAIL; 
 			if (read!=sizeof(double)) return E_FAIL;
+			if (i<collection->items.size())
+			   {par=(RealParameterObject *)collection->items[i];
+				par->SetValue(value);
+			   }
    		   }
+		//read the last converged solution; not present before version 2
+		ConvergedState state;
+		if (fileVersion>=2)
+		   {if (!state.Load(pstm)) return E_FAIL;
+		   }
+		Lock();
+		convergedState=state;
+		linearizedState=LinearizedState(); //the heat capacity applies to the previous flowsheet
+		Unlock();
 		//all ok 
 		return S_OK;
 	}
 
 	//! IPersistStream::Save
 	/*!
-	Save to persistence
+	Save to persistence. All data is collected in the persistence buffer and written by a single call
 	\param pstm [in] IStream to save to
 	\param fClearDirty [in] if set, we must clear the dirty flags
 	\return S_OK for success, or S_FALSE
@@ -739,61 +1126,69 @@ public:
 	{   if (!pstm) return E_POINTER;
 		unsigned int i;
 		ULONG written;
-		UINT length;
-		UINT fileVersion=CURRENTFILEVERSIONNUMBER;
+		UINT size;
 		RealParameterObject *par;
-		//save version number, in case of future changes to the format
-		if (FAILED(pstm->Write(&fileVersion,sizeof(UINT),&written))) return E_FAIL; //this is not a CAPE-OPEN function, we do not return a CAPE-OPEN error
-		if (written!=sizeof(UINT)) return E_FAIL;
-		//save name
-		length=(UINT)name.size();
-		if (FAILED(pstm->Write(&length,sizeof(UINT),&written))) return E_FAIL; 
-		if (written!=sizeof(UINT)) return E_FAIL;
-		if (FAILED(pstm->Write(name.c_str(),2*(length+1),&written))) return E_FAIL; 
-		if (written!=2*(length+1)) return E_FAIL;
-		//save description
-		length=(UINT)description.size();
-		if (FAILED(pstm->Write(&length,sizeof(UINT),&written))) return E_FAIL; 
-		if (written!=sizeof(UINT)) return E_FAIL;
-		if (FAILED(pstm->Write(description.c_str(),2*(length+1),&written))) return E_FAIL; 
-		if (written!=2*(length+1)) return E_FAIL;
-		//save parameter values
-		for (i=0;i<2;i++)
-		   {par=(RealParameterObject *)parameterCollection->items[i];
-			if (FAILED(pstm->Write(&par->value,sizeof(double),&written))) return E_FAIL; 
-			if (written!=sizeof(double)) return E_FAIL;
-		   }
+		//the name, description and buffer must not change while saving
+		ObjectLock lock(this);
+		size=GetPersistSize();
+		persistBuffer.Reset();
+		//version number, in case of future changes to the format, and size of the remaining data
+		persistBuffer.PutUINT(CURRENTFILEVERSIONNUMBER);
+		persistBuffer.PutUINT(size-2*sizeof(UINT));
+		//name and description
+		persistBuffer.PutString(GetName());
+		persistBuffer.PutString(GetDescription());
+		//parameter count and values
+		persistBuffer.PutUINT(PARAMETERCOUNT);
+		for (i=0;i<PARAMETERCOUNT;i++) persistBuffer.PutDouble(GetParameterValue(i));
+		//the last converged solution
+		convergedState.Save(persistBuffer);
+		ATLASSERT(persistBuffer.GetSize()==size);
+		//write all at once
+		if (FAILED(pstm->Write(persistBuffer.GetData(),size,&written))) return E_FAIL; //this is not a CAPE-OPEN function, we do not return a CAPE-OPEN error
+		if (written!=size) return E_FAIL;
 		//clear the dirty flags if so asked
 		if (fClearDirty)
 		   {dirty=false; 
-			//also on the parameters
-			for (i=0;i<parameterCollection->items.size();i++)
-			   {par=(RealParameterObject *)parameterCollection->items[i];
-				par->dirty=false;
+			//also on the parameters, if created
+			if (parameterCollection)
+			   {for (i=0;i<parameterCollection->items.size();i++)
+				   {par=(RealParameterObject *)parameterCollection->items[i];
+					par->dirty=false;
+				   }
 			   }
 		   }
 		return S_OK;
 	}
 
+	//! Size of the saved data
+	/*!
+	Returns the exact number of bytes written by Save. Must be called with the object lock held.
+	\return the size in bytes
+	\sa Save()
+	*/
+
+	UINT GetPersistSize()
+	{	UINT total;
+		total=2*sizeof(UINT); //version number and data size
+		total+=PersistBuffer::StringSize(GetName()); //length and data of name
+		total+=PersistBuffer::StringSize(GetDescription()); //length and data of description
+		total+=sizeof(UINT)+sizeof(double)*PARAMETERCOUNT; //count and values of parameters
+		total+=convergedState.GetSize(); //last converged solution
+		return total;
+	}
+
 	//! IPersistStream::GetSizeMax
 	/*!
-	Return the maximum size required to save this object
+	Return the maximum size required to save this object; this is the exact size
 	\param pcbSize [out] receives the size, cannot be NULL
 	\sa Save()
 	*/
 
 	STDMETHOD(GetSizeMax)(_ULARGE_INTEGER * pcbSize)
 	{   if (!pcbSize) return E_POINTER;
-		//calculate total size
-		UINT total;
-		UINT length;
-		total=sizeof(UINT); //version number
-		length=(UINT)name.size();
-		total+=sizeof(UINT)+2*(length+1); //size and data of name
-		length=(UINT)description.size();
-		total+=sizeof(UINT)+2*(length+1); //size and data of description
-		total+=sizeof(double)*2; //size of values of parameters
-		pcbSize->QuadPart=total;
+		ObjectLock lock(this);
+		pcbSize->QuadPart=GetPersistSize();
 		return NOERROR;
 	}
 
@@ -811,7 +1206,8 @@ public:
 
 
 	// ICapeUnitReport Methods
-	//  this is an optional interface; a sample report is implemented to show how it is done
+	//  this is an optional interface; a sample report is implemented to show how it is done, along with
+	//  a diagnostics report on the process-wide object pool and thermo metadata cache
 
 	//! ICapeUnitReport::get_reports
 	/*!
@@ -821,9 +1217,10 @@ public:
 
 	STDMETHOD(get_reports)(VARIANT * reports)
 	{	if (!reports) return E_POINTER; //not a valid pointer
+	    int i;
 	    CVariant reportList;
-	    reportList.MakeArray(1,VT_BSTR);
-	    reportList.AllocStringAt(0,L"Sample report");
+	    reportList.MakeArray(REPORTCOUNT,VT_BSTR);
+	    for (i=0;i<REPORTCOUNT;i++) reportList.AllocStringAt(i,reportNames[i]);
 	    *reports=reportList.ReturnValue(); //will be freed by caller, so make sure we do not own this value
 		return NOERROR;
 	}
@@ -840,8 +1237,7 @@ public:
 	     {SetError(L"A report was not selected",L"ICapeUnitReport",L"get_selectedReport");
 	      return ECapeUnknownHR;
 	     }
-	    //the selected report must be the sample report
-	    *report=SysAllocString(L"Sample report"); //will be freed by caller
+	    *report=SysAllocString(reportNames[selectedReportIndex]); //will be freed by caller
 		return NOERROR;
 	}
 
@@ -854,10 +1250,12 @@ public:
 
 	STDMETHOD(put_selectedReport)(BSTR report)
 	{	//request to select report
-	    if (CBSTR::Same(report,L"Sample report"))
-	     {selectedReportIndex=0; 
-	      return NOERROR;
-	     }
+	    int i;
+	    for (i=0;i<REPORTCOUNT;i++)
+	     if (CBSTR::Same(report,reportNames[i]))
+	      {selectedReportIndex=i; 
+	       return NOERROR;
+	      }
 	    //report not supported
 	    SetError(L"Invalid report selection: no such report",L"ICapeUnitReport",L"put_selectedReport");
 		return ECapeUnknownHR;
@@ -881,8 +1279,32 @@ public:
 	     {SetError(L"A report was not selected",L"ICapeUnitReport",L"ProduceReport");
 	      return ECapeUnknownHR;
 	     }
-	    //the selected report must be the sample report, return its content
-	    *reportContent=SysAllocString(L"Example Mixer Splitter Report Content"); //caller must free this value
+	    if (selectedReportIndex==0)
+	     {//the sample report
+	      *reportContent=SysAllocString(L"Example Mixer Splitter Report Content"); //caller must free this value
+	      return NOERROR;
+	     }
+	    //the diagnostics report; the calculation and product statistics are for this unit operation, the remaining statistics are process-wide
+	    wstring content;
+	    OLECHAR buf[256];
+	    LARGE_INTEGER frequency;
+	    QueryPerformanceFrequency(&frequency);
+	    Lock();
+	    double seconds=(double)calculationTime/frequency.QuadPart; //[s]
+	    swprintf_s(buf,256,L"Calculations: %u in %.3f s, %.1f calculations per second\r\n",calculationCount,seconds,(seconds>0)?calculationCount/seconds:0.0);
+	    content=buf;
+	    swprintf_s(buf,256,L"Outputs changed: %s\r\nCalculations with changed outputs: %u\r\nCalculations without changed outputs: %u\r\n",
+	        (outputsChanged)?L"yes":L"no",changedCalculations,unchangedCalculations);
+	    content+=buf;
+	    swprintf_s(buf,256,L"Calculations with extrapolated temperature: %u, estimated error of the last one: %.3g K\r\n",linearizedCalculations,linearizationErrorEstimate);
+	    Unlock();
+	    content+=buf;
+	    CalculationStatistics::GetStatistics(content);
+	    FlashCache::GetStatistics(content);
+	    ObjectPool::GetStatistics(content);
+	    swprintf_s(buf,256,L"Thermo metadata cache: %d property packages\r\n",ThermoMetadataCache::GetEntryCount());
+	    content+=buf;
+	    *reportContent=SysAllocString(content.c_str()); //caller must free this value
 		return NOERROR;
 	}
 	
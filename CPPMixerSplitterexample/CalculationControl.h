@@ -0,0 +1,136 @@
+#pragma once
+
+//! Calculation control class
+/*!
+  Controls a single calculation of the unit operation. The calculation
+  checks the control between calls to the thermodynamic server; it will
+  stop if the calculation is cancelled, or if the time budget for the
+  calculation has been exhausted. A call that is in progress (such as a
+  lengthy flash calculation) cannot be interrupted; cancellation is
+  cooperative.
+
+  If a progress log is set, each stage of the calculation is logged to
+  the simulation context as it starts; this is done on the thread that
+  calls Calculate, as the simulation context is bound to its apartment.
+
+  All members except the progress log can be accessed from multiple threads.
+*/
+
+class CalculationControl
+{
+	volatile LONG cancelled; /*!< set if the calculation is cancelled */
+	volatile LONG timedOut; /*!< set if the time budget was exhausted */
+	DWORD startTime; /*!< tick count at the start of the calculation [ms] */
+	DWORD budget; /*!< time budget for the calculation [ms], zero for no limit */
+	ICapeDiagnostics *diagnostics; /*!< progress log, NULL if progress is not logged */
+	wstring unitName; /*!< name of the unit operation, for the progress log */
+
+	public:
+
+	//! Constructor
+    /*!
+      Starts a calculation
+      \param budgetSeconds time budget for the calculation [s], zero or negative for no limit
+    */
+
+	CalculationControl(double budgetSeconds)
+	{cancelled=timedOut=0;
+	 startTime=GetTickCount();
+	 if (budgetSeconds>0)
+	    {if (budgetSeconds>4.0e6) budgetSeconds=4.0e6; //keep within range of a DWORD
+	     budget=(DWORD)(budgetSeconds*1000.0);
+	     if (budget==0) budget=1;
+	    }
+	 else budget=0;
+	 diagnostics=NULL;
+	}
+
+	//! Destructor
+    /*!
+      Releases the progress log
+    */
+
+	~CalculationControl()
+	{if (diagnostics) diagnostics->Release();
+	}
+
+	//! Set the progress log
+    /*!
+      Logs subsequent progress updates to the simulation context. Must be called on the
+      thread that calls Calculate, before the calculation starts.
+      \param simulationContext the simulation context; progress is only logged if it supports ICapeDiagnostics
+      \param name name of the unit operation
+      \sa SetProgress()
+    */
+
+	void SetProgressLog(IDispatch *simulationContext,const OLECHAR *name)
+	{ATLASSERT(!diagnostics);
+	 if (FAILED(simulationContext->QueryInterface(IID_ICapeDiagnostics,(LPVOID*)&diagnostics))) diagnostics=NULL;
+	 unitName=(name)?name:L"";
+	}
+
+	//! Cancel the calculation
+    /*!
+      Request the calculation to stop. The calculation will stop at the next check. Can be
+      called from any thread.
+      \sa Continue()
+    */
+
+	void Cancel()
+	{InterlockedExchange(&cancelled,1);
+	}
+
+	//! Check whether the calculation can continue
+    /*!
+      Must be called between calls to the thermodynamic server. Returns false if the
+      calculation was cancelled or if the time budget was exhausted; in that case
+      error receives a description
+      \param error receives the error description in case of false return value
+      \return true if the calculation can continue
+      \sa Cancel(), TimedOut()
+    */
+
+	bool Continue(wstring &error)
+	{if (cancelled)
+	    {error=L"The calculation was cancelled";
+	     return false;
+	    }
+	 if (budget)
+	    {if (GetTickCount()-startTime>budget) //unsigned subtraction, correct at wrap-around of the tick count
+	        {InterlockedExchange(&timedOut,1);
+	         error=L"The time budget for the calculation was exhausted";
+	         return false;
+	        }
+	    }
+	 return true;
+	}
+
+	//! Check for time-out
+    /*!
+      \return true if the calculation was stopped because the time budget was exhausted
+    */
+
+	bool TimedOut()
+	{return timedOut!=0;
+	}
+
+	//! Update the progress
+    /*!
+      Logs the progress of the calculation if a progress log is set; in that case this must 
+      be called on the thread that calls Calculate
+      \param percent progress in percent
+      \param stageDescription description of the current stage
+      \sa SetProgressLog()
+    */
+
+	void SetProgress(int percent,const OLECHAR *stageDescription)
+	{if (diagnostics)
+	    {OLECHAR buf[256];
+	     swprintf_s(buf,256,L"%s: %s (%d%%)",unitName.c_str(),stageDescription,percent);
+	     BSTR message=SysAllocString(buf);
+	     diagnostics->LogMessage(message);
+	     SysFreeString(message);
+	    }
+	}
+
+};
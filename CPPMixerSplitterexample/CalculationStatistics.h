@@ -0,0 +1,101 @@
+#pragma once
+#include <psapi.h>
+
+#pragma comment(lib,"psapi.lib") //GetProcessMemoryInfo
+
+//! Calculation statistics class
+/*!
+  Process-wide counters of calculations and of calls to the material objects
+  of the thermodynamic server, for throughput measurements: the number of
+  thermo calls per calculation shows the effect of the shortcuts that avoid
+  calls to the material objects. The counters include all unit operation
+  instances in the process, so the ratio is correct also if unit operations
+  are calculated concurrently.
+
+  The counters are maintained with interlocked operations; all functions
+  are thread-safe.
+*/
+
+class CalculationStatistics
+{
+	//! Thermo call counter
+    /*!
+      \return the process-wide counter of thermo calls
+    */
+
+	static volatile LONG &ThermoCalls()
+	{static volatile LONG count=0;
+	 return count;
+	}
+
+	//! Calculation counter
+    /*!
+      \return the process-wide counter of calculations
+    */
+
+	static volatile LONG &Calculations()
+	{static volatile LONG count=0;
+	 return count;
+	}
+
+	//! Stale feed enthalpy counter
+    /*!
+      \return the process-wide counter of cached feed enthalpies that were not reproduced after validation
+    */
+
+	static volatile LONG &StaleFeedEnthalpies()
+	{static volatile LONG count=0;
+	 return count;
+	}
+
+	public:
+
+	//! Count a thermo call
+    /*!
+      Called by the material object wrappers for each call to a material object
+    */
+
+	static void CountThermoCall()
+	{InterlockedIncrement(&ThermoCalls());
+	}
+
+	//! Count a calculation
+    /*!
+      Called by the unit operation for each calculation
+    */
+
+	static void CountCalculation()
+	{InterlockedIncrement(&Calculations());
+	}
+
+	//! Count a stale feed enthalpy
+    /*!
+      Called by the feed stage if a cached feed enthalpy differs from its evaluation after validation
+    */
+
+	static void CountStaleFeedEnthalpy()
+	{InterlockedIncrement(&StaleFeedEnthalpies());
+	}
+
+	//! Get the statistics
+    /*!
+      Appends the thermo calls, the calculations and the memory use of the process to a report
+      \param report the report to append to
+    */
+
+	static void GetStatistics(wstring &report)
+	{OLECHAR buf[256];
+	 LONG calls=ThermoCalls(),calculations=Calculations();
+	 PROCESS_MEMORY_COUNTERS memory;
+	 swprintf_s(buf,256,L"Thermo calls: %d in %d calculations, %.1f per calculation\r\n",calls,calculations,(calculations)?(double)calls/calculations:0.0);
+	 report+=buf;
+	 swprintf_s(buf,256,L"Cached feed enthalpies replaced after validation: %d\r\n",(LONG)StaleFeedEnthalpies());
+	 report+=buf;
+	 memory.cb=sizeof(memory);
+	 if (GetProcessMemoryInfo(GetCurrentProcess(),&memory,sizeof(memory)))
+	    {swprintf_s(buf,256,L"Process memory: %.1f MB working set, peak %.1f MB\r\n",memory.WorkingSetSize/1048576.0,memory.PeakWorkingSetSize/1048576.0);
+	     report+=buf;
+	    }
+	}
+
+};
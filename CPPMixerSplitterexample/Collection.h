@@ -5,6 +5,7 @@
 
 #include "CPPMixerSplitterexample.h"
 #include "CAPEOPENBaseObject.h"
+#include "ObjectPool.h"
 
 //! Generic CAPE-OPEN Collection class
 /*!
@@ -28,8 +29,8 @@ public:
     /*!
       Helper function for creating the collection as an exposable COM object. After calling CreateCollection, the reference
       count is one; do not delete the returned object. Use Release() instead
-      \param name name of the collection
-      \param description description of the collection
+      \param name name of the collection, a string literal
+      \param description description of the collection, a string literal
       \sa CCollection()
     */
     
@@ -37,8 +38,7 @@ public:
     {CComObject<CCollection> *p;
      CComObject<CCollection>::CreateInstance(&p); //create the instance with zero references
      p->AddRef(); //now it has one reference, the caller must Release this object
-     p->name=name;
-     p->description=description;
+     p->SetIdentification(name,description);
      return p;
     }
 
@@ -78,6 +78,10 @@ public:
 
 	DECLARE_PROTECT_FINAL_CONSTRUCT()
 
+	//allocate from the object pool, as each unit operation creates many of these objects
+
+	DECLARE_POOLED_ALLOCATION()
+
 	// ICapeCollection Methods
 
 	//! ICapeCollection::Item
@@ -96,7 +100,7 @@ public:
 	    if (id.vt==VT_BSTR)
 	     {//string
 	      for (index=0;index<(int)items.size();index++)
-	       {if (CBSTR::Same(id.bstrVal,items[index]->name.c_str()))
+	       {if (CBSTR::Same(id.bstrVal,items[index]->GetName()))
 	         break;
 	       }
 	      if (index==items.size())
@@ -0,0 +1,311 @@
+#pragma once
+#include "PersistBuffer.h"
+
+#define MAXSTATESTREAMSIZE (1024*1024) //bound on the size of a version 2 state if the size of the stream is unknown
+#define CONVERGEDSTATEENTHALPYTOLERANCE 0.1 //maximum deviation of the enthalpy at the stored temperature from the flash enthalpy [J/mol]
+
+//! Converged state class
+/*!
+  Holds the last converged solution of the PH flash of the unit operation:
+  the product temperature, pressure, composition and present phases, along
+  with a fingerprint of the flash inputs and the identity of the property
+  package that performed the flash, see ThermoMetadata::identity. The state
+  is saved with the unit operation, so that it is available on the first
+  calculation after loading a flowsheet.
+
+  The identity only covers the thermo version, compounds and phases of the
+  property package, so it does not tell apart two property packages with
+  different models for the same compounds and phases. If the identity and
+  the flash inputs of a calculation match, the stored temperature is
+  therefore only a candidate: the unit operation sets the product at that
+  temperature and accepts it if the enthalpy there is the flash enthalpy
+  within CONVERGEDSTATEENTHALPYTOLERANCE. Otherwise the stored state serves
+  as initial estimate for the flash. States saved before the identity was
+  stored have identity zero and match nothing.
+
+  This class is not thread-safe; the unit operation protects it.
+*/
+
+class ConvergedState
+{	public:
+
+	bool valid; /*!< set if this contains a converged solution */
+	double temperature; /*!< product temperature [K] */
+	double pressure; /*!< product pressure [Pa] */
+	vector<double> composition; /*!< product composition [mol/mol] */
+	vector<wstring> presentPhases; /*!< labels of the phases present in the product */
+	ULONGLONG fingerprint; /*!< fingerprint of the flash inputs: pressure, enthalpy and composition */
+	ULONGLONG identity; /*!< identity of the property package, see ThermoMetadata::identity; zero if unknown */
+
+	//! Constructor
+    /*!
+      Creates an empty state
+    */
+
+	ConvergedState()
+	{valid=false;
+	 temperature=pressure=0;
+	 fingerprint=identity=0;
+	}
+
+	//! Calculate the fingerprint of flash inputs
+    /*!
+      Calculates a 64-bit FNV-1a hash of the flash inputs. Exact values are hashed; any
+      change to the inputs results in a different fingerprint.
+      \param P pressure [Pa]
+      \param H enthalpy [J/mol]
+      \param composition overall composition [mol/mol]
+      \return the fingerprint
+    */
+
+	static ULONGLONG Fingerprint(double P,double H,CVariant &composition)
+	{ULONGLONG hash=14695981039346656037ui64; //FNV offset basis
+	 int i;
+	 double x;
+	 Hash(hash,&P,sizeof(double));
+	 Hash(hash,&H,sizeof(double));
+	 for (i=0;i<composition.GetCount();i++)
+	    {x=composition.GetDoubleAt(i);
+	     Hash(hash,&x,sizeof(double));
+	    }
+	 return hash;
+	}
+
+	//! Add data to a hash
+    /*!
+      Adds data to a 64-bit FNV-1a hash; also used for other fingerprints, such as the keys of the FlashCache
+      \param hash the hash to update
+      \param data the data
+      \param size size of the data in bytes
+    */
+
+	static void Hash(ULONGLONG &hash,const void *data,size_t size)
+	{const BYTE *p=(const BYTE *)data;
+	 size_t i;
+	 for (i=0;i<size;i++)
+	    {hash^=p[i];
+	     hash*=1099511628211ui64; //FNV prime
+	    }
+	}
+
+	//! Check whether the state is the solution for the given flash inputs
+    /*!
+      \param identity identity of the property package
+      \param fingerprint fingerprint of the flash inputs
+      \param P pressure [Pa]
+      \param composition overall composition [mol/mol]
+      \return true if this state may be the solution of a flash with these inputs; the caller verifies the enthalpy
+      \sa Fingerprint()
+    */
+
+	bool Matches(ULONGLONG identity,ULONGLONG fingerprint,double P,CVariant &composition)
+	{int i;
+	 if ((!valid)||(!identity)||(identity!=this->identity)) return false;
+	 if ((fingerprint!=this->fingerprint)||(P!=pressure)) return false;
+	 if ((int)this->composition.size()!=composition.GetCount()) return false;
+	 for (i=0;i<composition.GetCount();i++)
+	    if (this->composition[i]!=composition.GetDoubleAt(i)) return false;
+	 return true;
+	}
+
+	//! Set the state
+    /*!
+      Stores a converged solution
+      \param identity identity of the property package
+      \param fingerprint fingerprint of the flash inputs
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param composition overall composition [mol/mol]
+      \param phaseList list of present phases
+      \return true if the state changed, false if it already held this solution
+    */
+
+	bool Set(ULONGLONG identity,ULONGLONG fingerprint,double T,double P,CVariant &composition,CVariant &phaseList)
+	{int i;
+	 if ((Matches(identity,fingerprint,P,composition))&&(T==temperature)&&(SamePhases(phaseList))) return false;
+	 this->identity=identity;
+	 this->fingerprint=fingerprint;
+	 temperature=T;
+	 pressure=P;
+	 this->composition.resize(composition.GetCount());
+	 for (i=0;i<composition.GetCount();i++) this->composition[i]=composition.GetDoubleAt(i);
+	 presentPhases.resize(phaseList.GetCount());
+	 for (i=0;i<phaseList.GetCount();i++)
+	    {BSTR phase=phaseList.GetStringViewAt(i); //owned by phaseList
+	     presentPhases[i]=(phase)?phase:L"";
+	    }
+	 valid=true;
+	 return true;
+	}
+
+	//! Check whether the present phases are those of the state
+    /*!
+      \param phaseList list of present phases
+      \return true if the same phases are present, in the same order
+    */
+
+	bool SamePhases(CVariant &phaseList)
+	{unsigned int i;
+	 if ((int)presentPhases.size()!=phaseList.GetCount()) return false;
+	 for (i=0;i<presentPhases.size();i++)
+	    if (!CBSTR::Same(presentPhases[i].c_str(),phaseList.GetStringViewAt(i))) return false;
+	 return true;
+	}
+
+	//! Check whether a phase was present
+    /*!
+      \param phaseLabel label of the phase
+      \return true if the phase is present in this state
+    */
+
+	bool IsPresent(const OLECHAR *phaseLabel) const
+	{unsigned int i;
+	 for (i=0;i<presentPhases.size();i++)
+	    if (CBSTR::Same(presentPhases[i].c_str(),phaseLabel)) return true;
+	 return false;
+	}
+
+	//! Size of the saved state
+    /*!
+      \return the number of bytes appended by Save()
+      \sa Save()
+    */
+
+	UINT GetSize()
+	{UINT size;
+	 unsigned int i;
+	 size=sizeof(UINT); //valid flag
+	 if (!valid) return size;
+	 size+=2*sizeof(double)+2*sizeof(ULONGLONG); //temperature, pressure, fingerprint, identity
+	 size+=sizeof(UINT)+sizeof(double)*(UINT)composition.size(); //count and composition
+	 size+=sizeof(UINT); //phase count
+	 for (i=0;i<presentPhases.size();i++) size+=PersistBuffer::StringSize(presentPhases[i].c_str()); //length and label
+	 return size;
+	}
+
+	//! Save the state
+    /*!
+      \param buffer the buffer to append to
+      \sa Load(), GetSize()
+    */
+
+	void Save(PersistBuffer &buffer)
+	{UINT count;
+	 unsigned int i;
+	 buffer.PutUINT((valid)?1:0);
+	 if (!valid) return;
+	 buffer.PutDouble(temperature);
+	 buffer.PutDouble(pressure);
+	 buffer.Put(&fingerprint,sizeof(ULONGLONG));
+	 buffer.Put(&identity,sizeof(ULONGLONG));
+	 count=(UINT)composition.size();
+	 buffer.PutUINT(count);
+	 if (count) buffer.Put(&composition[0],sizeof(double)*count);
+	 count=(UINT)presentPhases.size();
+	 buffer.PutUINT(count);
+	 for (i=0;i<count;i++) buffer.PutString(presentPhases[i].c_str());
+	}
+
+	//! Load the state
+    /*!
+      \param buffer the buffer to read from
+      \param fileVersion version of the file; the identity is stored from version 4
+      \return true in case of success, false if the data is not valid
+      \sa Save()
+    */
+
+	bool Load(PersistBuffer &buffer,UINT fileVersion)
+	{UINT count;
+	 unsigned int i;
+	 valid=false;
+	 identity=0;
+	 if (!buffer.GetUINT(count)) return false;
+	 if (!count) return true;
+	 if (!buffer.GetDouble(temperature)) return false;
+	 if (!buffer.GetDouble(pressure)) return false;
+	 if (!buffer.Get(&fingerprint,sizeof(ULONGLONG))) return false;
+	 if (fileVersion>=4) if (!buffer.Get(&identity,sizeof(ULONGLONG))) return false;
+	 if (!buffer.GetUINT(count)) return false;
+	 if (count>buffer.Remaining()/sizeof(double)) return false; //check before allocating
+	 composition.resize(count);
+	 if (count) if (!buffer.Get(&composition[0],sizeof(double)*count)) return false;
+	 if (!buffer.GetUINT(count)) return false;
+	 if (count>buffer.Remaining()/PersistBuffer::StringSize(L"")) return false; //check before allocating
+	 presentPhases.resize(count);
+	 for (i=0;i<count;i++)
+	    if (!buffer.GetString(presentPhases[i])) return false;
+	 valid=true;
+	 return true;
+	}
+
+	//! Load the state from a version 2 file
+    /*!
+      Version 2 files are read field by field from the stream. Counts and lengths are
+      checked against the remaining size of the stream before allocating. Version 2
+      files do not store the identity of the property package.
+      \param pstm IStream to load from
+      \return true in case of success
+      \sa Save()
+    */
+
+	bool Load(IStream *pstm)
+	{UINT count,length;
+	 unsigned int i;
+	 ULONGLONG remaining=Remaining(pstm);
+	 valid=false;
+	 identity=0;
+	 if (!Read(pstm,&count,sizeof(UINT))) return false;
+	 if (!count) return true;
+	 if (!Read(pstm,&temperature,sizeof(double))) return false;
+	 if (!Read(pstm,&pressure,sizeof(double))) return false;
+	 if (!Read(pstm,&fingerprint,sizeof(ULONGLONG))) return false;
+	 if (!Read(pstm,&count,sizeof(UINT))) return false;
+	 if (count>remaining/sizeof(double)) return false; //check before allocating
+	 composition.resize(count);
+	 if (count) if (!Read(pstm,&composition[0],sizeof(double)*count)) return false;
+	 if (!Read(pstm,&count,sizeof(UINT))) return false;
+	 if (count>remaining/(sizeof(UINT)+sizeof(OLECHAR))) return false; //length and terminating zero of each label
+	 presentPhases.resize(count);
+	 for (i=0;i<count;i++)
+	    {if (!Read(pstm,&length,sizeof(UINT))) return false;
+	     if (length>=remaining/sizeof(OLECHAR)) return false;
+	     vector<OLECHAR> buf(length+1); //space for terminating zero
+	     if (!Read(pstm,&buf[0],2*(length+1))) return false;
+	     buf[length]=0;
+	     presentPhases[i]=&buf[0];
+	    }
+	 valid=true;
+	 return true;
+	}
+
+	private:
+
+	//! Read from stream
+    /*!
+      \return true if all data was read
+    */
+
+	static bool Read(IStream *pstm,void *data,ULONG size)
+	{ULONG read;
+	 if (FAILED(pstm->Read(data,size,&read))) return false;
+	 return (read==size);
+	}
+
+	//! Remaining size of a stream
+    /*!
+      \return the number of bytes after the current position, or MAXSTATESTREAMSIZE if the
+       stream cannot report its size
+    */
+
+	static ULONGLONG Remaining(IStream *pstm)
+	{STATSTG stat;
+	 LARGE_INTEGER zero;
+	 ULARGE_INTEGER position;
+	 zero.QuadPart=0;
+	 if (FAILED(pstm->Seek(zero,STREAM_SEEK_CUR,&position))) return MAXSTATESTREAMSIZE;
+	 if (FAILED(pstm->Stat(&stat,STATFLAG_NONAME))) return MAXSTATESTREAMSIZE;
+	 if (stat.cbSize.QuadPart<position.QuadPart) return 0;
+	 return stat.cbSize.QuadPart-position.QuadPart;
+	}
+
+};
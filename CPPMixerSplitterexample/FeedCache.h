@@ -0,0 +1,106 @@
+#pragma once
+
+#define FEEDCACHEENTHALPYTOLERANCE 0.1 //maximum deviation of a re-evaluated feed enthalpy from the cached value [J/mol]
+
+//! Feed cache class
+/*!
+  Holds the molar enthalpy of the last state of a feed, along with the
+  temperature, pressure, composition and present phases of that state. If
+  the feed is in the same state at the next calculation, the enthalpy is
+  taken from the cache, so that the feed material need not be duplicated
+  and its phase enthalpies need not be calculated. This applies to feeds
+  from upstream units that did not change; the flow of the feed may
+  change, as the molar enthalpy does not depend on it.
+
+  The state is compared exactly. Temperature, pressure and composition do
+  not determine the state if there are more phases than compounds, such
+  as a pure compound at its boiling point; such states are not cached.
+
+  The cached enthalpy depends on the property package, which is not
+  identified by the ThermoMetadata: packages with the same compounds and
+  phases share metadata. Each validation therefore marks the cache as not
+  verified; the next time the feed is in the cached state its enthalpy is
+  evaluated anyway, and compared with the cached value. The cache is only
+  used without evaluation once a value is verified.
+
+  The cache is kept by the feed port and copied to and from the feed
+  contribution of a calculation. This class is not thread-safe.
+*/
+
+class FeedCache
+{	public:
+
+	bool valid; /*!< set if this holds the enthalpy of a feed state */
+	double temperature; /*!< temperature [K] */
+	double pressure; /*!< pressure [Pa] */
+	vector<double> composition; /*!< overall composition [mol/mol] */
+	vector<wstring> presentPhases; /*!< labels of the present phases */
+	double molarEnthalpy; /*!< molar enthalpy [J/mol] */
+	bool verified; /*!< set if the enthalpy was evaluated since the last validation */
+
+	//! Constructor
+    /*!
+      Creates an empty cache
+    */
+
+	FeedCache()
+	{valid=false;
+	 verified=false;
+	 temperature=pressure=molarEnthalpy=0;
+	}
+
+	//! Check whether a state can be cached
+    /*!
+      \param nCompounds number of compounds
+      \param phaseList list of present phases
+      \return true if temperature, pressure and composition determine the state
+    */
+
+	static bool IsCacheable(int nCompounds,CVariant &phaseList)
+	{return (phaseList.GetCount()<=nCompounds);
+	}
+
+	//! Check whether the cache holds a state
+    /*!
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param composition overall composition [mol/mol]
+      \param phaseList list of present phases
+      \return true if the cache holds the enthalpy of this state
+    */
+
+	bool Matches(double T,double P,vector<double> &composition,CVariant &phaseList)
+	{unsigned int i;
+	 if ((!valid)||(T!=temperature)||(P!=pressure)) return false;
+	 if (composition!=this->composition) return false;
+	 if ((int)presentPhases.size()!=phaseList.GetCount()) return false;
+	 for (i=0;i<presentPhases.size();i++)
+	    if (!CBSTR::Same(presentPhases[i].c_str(),phaseList.GetStringViewAt(i))) return false;
+	 return true;
+	}
+
+	//! Set the cache
+    /*!
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param composition overall composition [mol/mol]
+      \param phaseList list of present phases
+      \param H molar enthalpy [J/mol]
+    */
+
+	void Set(double T,double P,vector<double> &composition,CVariant &phaseList,double H)
+	{int i;
+	 temperature=T;
+	 pressure=P;
+	 this->composition=composition;
+	 presentPhases.resize(phaseList.GetCount());
+	 for (i=0;i<phaseList.GetCount();i++)
+	    {BSTR phase=phaseList.GetStringViewAt(i); //owned by phaseList
+	     presentPhases[i]=(phase)?phase:L"";
+	    }
+	 molarEnthalpy=H;
+	 valid=true;
+	 verified=true;
+	}
+
+};
@@ -0,0 +1,406 @@
+#pragma once
+#include "MaterialAccess.h"
+#include "CalculationControl.h"
+#include "FeedCache.h"
+
+#define IDENTICALSTATETOLERANCE 1e-9 //relative tolerance on temperature and pressure, and absolute tolerance on mole fractions, for feeds in identical states
+
+//! Feed contribution class
+/*!
+  Holds the contribution of a single feed to the mixed product: the component
+  flows, the enthalpy flow and the pressure. The contribution is calculated
+  by Ingest() from the material object connected to the feed port; the
+  calculation only touches members of this class, so that the contributions
+  of different feeds can be calculated concurrently. The enthalpy of a 
+  feed state is cached; the cache is kept by the feed port between 
+  calculations.
+
+  \sa FeedStage
+*/
+
+class FeedContribution
+{	public:
+
+	Material material; /*!< the material connected to the feed port; not valid if the port is not connected */
+	Material duplicateMaterial; /*!< duplicate of the feed material on which the enthalpy was calculated; not valid for zero flow */
+	double pressure; /*!< pressure of the feed [Pa] */
+	double temperature; /*!< temperature of the feed [K] */
+	double flow; /*!< total flow of the feed [mol/s] */
+	double enthalpy; /*!< enthalpy flow of the feed [J/s] */
+	vector<double> composition; /*!< composition of the feed [mol/mol]; zero for zero flow */
+	vector<double> componentFlows; /*!< component flows of the feed [mol/s] */
+	CVariant presentPhases; /*!< the phases present in the feed */
+	FeedCache cache; /*!< enthalpy of the last state of the feed; copied from and to the feed port */
+	bool stateRead; /*!< set if the state has been read */
+	bool ok; /*!< set if the contribution was calculated successfully */
+	wstring error; /*!< error description in case of failure */
+
+	//! Constructor
+    /*!
+      Initializes an empty contribution
+    */
+
+	FeedContribution()
+	{pressure=temperature=flow=enthalpy=0;
+	 stateRead=false;
+	 ok=false;
+	}
+
+	//! Read the state of the feed
+    /*!
+      Obtains pressure and flow from the feed material and, for a feed with flow, the 
+      composition, temperature and list of present phases. The temperature and present 
+      phases are used to detect feeds in identical states, and feeds of which the enthalpy
+      is cached. Feeds without flow do not contribute to the product; their temperature
+      and composition are only needed if the total flow is zero, and are then read by 
+      the unit operation.
+      \param nCompounds number of compounds
+      \param control the control of the current calculation
+      \return true in case of success
+      \sa Ingest()
+    */
+
+	template <class W> bool Read(int nCompounds,CalculationControl *control)
+	{int j;
+	 CVariant value;
+	 MaterialAccess<W> feed(material);
+	 //init
+	 composition.resize(nCompounds);
+	 componentFlows.resize(nCompounds);
+	 for (j=0;j<nCompounds;j++) composition[j]=componentFlows[j]=0;
+	 stateRead=false;
+	 ok=false;
+	 if (!control->Continue(error)) return false;
+	 //get the pressure
+	 if (!feed.GetOverallProperty(PROPERTY_PRESSURE,BASIS_UNDEFINED,value,error)) return false;
+	 //check count
+	 if (value.GetCount()!=1)
+	    {error=L"Invalid values for pressure from material object: scalar expected";
+	     return false;
+	    }
+	 pressure=value.GetDoubleAt(0);
+	 //get total flow
+	 if (!feed.GetOverallProperty(PROPERTY_TOTALFLOW,BASIS_MOLE,value,error)) return false;
+	 //check count
+	 if (value.GetCount()!=1)
+	    {error=L"Invalid values for total flow from material object: scalar expected";
+	     return false;
+	    }
+	 flow=value.GetDoubleAt(0); //flow of this feed
+	 if (flow>0)
+	    {//get the composition
+	     if (!feed.GetOverallProperty(PROPERTY_FRACTION,BASIS_MOLE,value,error)) return false;
+	     //check count
+	     if (value.GetCount()!=nCompounds)
+	        {error=L"Invalid values for overall fraction from material object: unexpected number of values";
+	         return false;
+	        }
+	     //component flows
+	     for (j=0;j<nCompounds;j++) 
+	        {composition[j]=value.GetDoubleAt(j);
+	         componentFlows[j]=flow*composition[j]; // [mol/s] = [mol/s]*[mol/mol]
+	        }
+	     //get the temperature
+	     if (!feed.GetOverallProperty(PROPERTY_TEMPERATURE,BASIS_UNDEFINED,value,error)) return false;
+	     //check count
+	     if (value.GetCount()!=1)
+	        {error=L"Invalid values for temperature from material object: scalar expected";
+	         return false;
+	        }
+	     temperature=value.GetDoubleAt(0);
+	     //get the present phases; this does not change the feed material
+	     if (!feed.GetListOfPresentPhases(presentPhases,error)) return false;
+	    }
+	 stateRead=true;
+	 return true;
+	}
+
+	//! Compare the state of two feeds
+    /*!
+      Checks whether two feeds have the same temperature, pressure and present phases, 
+      within IDENTICALSTATETOLERANCE. Both feeds must have been read with Read(), and 
+      both must have a non-zero flow. 
+      \param other the feed to compare with
+      \param nCompounds number of compounds
+      \param sameComposition receives whether the compositions are the same as well
+      \return true if the feeds are in the same state
+    */
+
+	bool SameState(FeedContribution &other,int nCompounds,bool &sameComposition)
+	{int j;
+	 ATLASSERT((flow>0)&&(other.flow>0));
+	 sameComposition=false;
+	 if (fabs(temperature-other.temperature)>IDENTICALSTATETOLERANCE*temperature) return false;
+	 if (fabs(pressure-other.pressure)>IDENTICALSTATETOLERANCE*pressure) return false;
+	 if (presentPhases.GetCount()!=other.presentPhases.GetCount()) return false;
+	 for (j=0;j<presentPhases.GetCount();j++)
+	    if (!CBSTR::Same(presentPhases.GetStringViewAt(j),other.presentPhases.GetStringViewAt(j))) return false;
+	 //same state; check the composition
+	 for (j=0;j<nCompounds;j++)
+	    if (fabs(componentFlows[j]/flow-other.componentFlows[j]/other.flow)>IDENTICALSTATETOLERANCE) return true;
+	 sameComposition=true;
+	 return true;
+	}
+
+	//! Calculate the contribution of the feed
+    /*!
+      Reads the state of the feed, unless already done by Read(), and obtains its 
+      enthalpy. If the feed is in the state of which the enthalpy is cached, the enthalpy 
+      is taken from the cache, unless the cache has not been verified since the last 
+      validation; the enthalpy is then evaluated and compared with the cached value. A feed that results from a flash normally has its overall enthalpy 
+      set; in that case the enthalpy is taken from the feed material. Otherwise the
+      enthalpy of the present phases is calculated on a duplicate of the feed material (we are
+      not allowed to change the status of material objects connected to the feed,
+      this includes performing property calculations); duplicateMaterial is only set
+      in this case. The result is stored in ok;
+      in case of failure, error contains the error description. The calculation
+      control is checked before each expensive call to the material object.
+      The material objects are accessed through MaterialAccess<W>, where W is the
+      wrapper type selected at validation.
+      \param nCompounds number of compounds
+      \param control the control of the current calculation
+      \return true in case of success
+      \sa Read()
+    */
+
+	template <class W> bool Ingest(int nCompounds,CalculationControl *control)
+	{double molarEnthalpy; //[J/mol]
+	 bool available;
+	 bool cached;
+	 CVariant value;
+	 enthalpy=0;
+	 ok=false;
+	 if (!stateRead)
+	    if (!Read<W>(nCompounds,control)) return false;
+	 if (flow>0)
+	    {cached=cache.Matches(temperature,pressure,composition,presentPhases);
+	     if ((cached)&&(cache.verified)) molarEnthalpy=cache.molarEnthalpy; //feed did not change
+	     else
+	        {if (!control->Continue(error)) return false;
+	         //use the overall enthalpy of the feed, if set
+	         if (!MaterialAccess<W>(material).TryGetOverallProperty(PROPERTY_ENTHALPY,BASIS_MOLE,value,available,error)) return false;
+	         if (available)
+	            {//check count
+	             if (value.GetCount()!=1)
+	                {error=L"Invalid values for overall enthalpy from material object: scalar expected";
+	                 return false;
+	                }
+	             molarEnthalpy=value.GetDoubleAt(0);
+	            }
+	         else
+	            {//calculate enthalpy contributions of present phases on duplicate material object
+	             if (!material.Duplicate(duplicateMaterial,error)) return false;
+	             MaterialAccess<W> duplicate(duplicateMaterial);
+	             if (!MolarEnthalpy(duplicate,control,molarEnthalpy,error)) return false;
+	            }
+	         //a cached enthalpy that is not reproduced after validation is from another property package
+	         if ((cached)&&(fabs(molarEnthalpy-cache.molarEnthalpy)>FEEDCACHEENTHALPYTOLERANCE)) CalculationStatistics::CountStaleFeedEnthalpy();
+	         //cache the enthalpy of this state
+	         if (FeedCache::IsCacheable(nCompounds,presentPhases)) cache.Set(temperature,pressure,composition,presentPhases,molarEnthalpy);
+	         else cache.valid=false;
+	        }
+	     enthalpy=flow*molarEnthalpy; // [J/s]=[mol/s]*[J/mol]
+	    }
+	 //all ok
+	 ok=true;
+	 return true;
+	}
+
+	//! Calculate the molar enthalpy of a material
+    /*!
+      Calculates the enthalpy of the present phases and returns the phase fraction weighted 
+      sum. The enthalpy is calculated on the material, so this must not be a material 
+      connected to a feed port. Also used for the product in case the outlet temperature
+      is specified.
+      \param material the material, at equilibrium
+      \param control the control of the current calculation
+      \param H receives the molar enthalpy [J/mol]
+      \param error error description in case of failure
+      \return true in case of success
+    */
+
+	template <class W> static bool MolarEnthalpy(MaterialAccess<W> &material,CalculationControl *control,double &H,wstring &error)
+	{int k;
+	 double phaseFraction; //[mol/mol]
+	 CVariant value,phaseList;
+	 H=0;
+	 //get the list of present phases
+	 if (!material.GetListOfPresentPhases(phaseList,error)) return false;
+	 //loop over all phases to get phase contribution of enthalpy
+	 for (k=0;k<phaseList.GetCount();k++)
+	    {BSTR phaseName=phaseList.GetStringViewAt(k); //owned by phaseList
+	     //get the phase fraction for this phase
+	     if (!material.GetSinglePhaseProperty(PROPERTY_PHASEFRACTION,phaseName,KEYWORD_NONE,BASIS_MOLE,value,error)) return false;
+	     //check count
+	     if (value.GetCount()!=1)
+	        {error=L"Invalid values for phase fraction from material object: scalar expected";
+	         return false;
+	        }
+	     phaseFraction=value.GetDoubleAt(0);
+	     if (phaseFraction>0)
+	        {//calculate enthalpy for this phase
+	         if (!control->Continue(error)) return false;
+	         if (!material.CalcSinglePhaseProperty(PROPERTY_ENTHALPY,phaseName,error)) return false;
+	         //get the value of enthalpy
+	         if (!material.GetSinglePhaseProperty(PROPERTY_ENTHALPY,phaseName,KEYWORD_MIXTURE,BASIS_MOLE,value,error)) return false;
+	         //check count
+	         if (value.GetCount()!=1)
+	            {error=L"Invalid values for enthalpy from material object: scalar expected";
+	             return false;
+	            }
+	         //add contribution to total enthalpy
+	         H+=phaseFraction*value.GetDoubleAt(0); // [J/mol]+=[mol/mol]*[J/mol]
+	        }
+	    }
+	 return true;
+	}
+
+};
+
+//! Feed stage class
+/*!
+  Calculates the contributions of a number of feeds, either sequentially on
+  the calling thread, or concurrently on the system thread pool. The calling
+  thread calculates the first feed itself, and waits for the others to finish.
+
+  Concurrent calculation is only allowed if each feed is connected to its own
+  material object and the material objects are thread-safe; the material
+  objects are called from worker threads in the multi-threaded apartment.
+  Material objects of the simulation environment are bound to the apartment
+  in which they were obtained, unless they aggregate the free-threaded
+  marshaler. The feeds are therefore only calculated concurrently if all
+  feed material objects are free-threaded; otherwise they are calculated on
+  the calling thread. A duplicate that a worker creates is only kept if it
+  is free-threaded as well; otherwise the worker releases it, and the
+  caller creates the duplicate it needs on its own thread.
+
+  The stage can also only read the state of the feeds, so that the caller
+  can inspect the states before deciding whether the enthalpies are needed;
+  the reads are then made concurrently under the same conditions, and a
+  later run of the stage does not read the states again.
+
+  The contributions are stored per feed. The caller reduces them in feed order,
+  so that the result does not depend on the order in which the feeds complete.
+
+  \sa FeedContribution
+*/
+
+class FeedStage
+{
+	FeedContribution **feeds; /*!< the feeds to calculate */
+	int nFeeds; /*!< number of feeds */
+	int nCompounds; /*!< number of compounds */
+	CalculationControl *control; /*!< the control of the current calculation */
+	volatile LONG pending; /*!< number of feeds that are calculated by the thread pool and have not yet finished */
+	HANDLE done; /*!< signalled when the last pending feed has finished */
+
+	//! Thread pool work item
+    /*!
+      Holds a reference to the stage and the feed to calculate
+    */
+
+	struct WorkItem
+	{FeedStage *stage; /*!< the stage */
+	 FeedContribution *feed; /*!< the feed to calculate */
+	 bool readOnly; /*!< set to only read the state of the feed */
+	};
+
+	//! Calculate a single feed
+    /*!
+      \param feed the feed to calculate
+      \param readOnly set to only read the state of the feed; the result is in its stateRead and error members
+    */
+
+	template <class W> void Process(FeedContribution *feed,bool readOnly)
+	{if (readOnly) feed->Read<W>(nCompounds,control);
+	 else feed->Ingest<W>(nCompounds,control);
+	}
+
+	//! Thread pool entry point
+    /*!
+      Calculates a single feed contribution on a thread pool thread
+      \param context the WorkItem
+      \return zero
+    */
+
+	template <class W> static DWORD WINAPI IngestWorker(LPVOID context)
+	{WorkItem *item=(WorkItem *)context;
+	 HRESULT hr=CoInitializeEx(NULL,COINIT_MULTITHREADED);
+	 item->stage->Process<W>(item->feed,item->readOnly);
+	 if ((item->feed->duplicateMaterial.IsValid())&&(!item->feed->duplicateMaterial.IsFreeThreaded()))
+	    {//bound to this apartment; release it here
+	     Material none;
+	     item->feed->duplicateMaterial.Swap(none);
+	    }
+	 if (SUCCEEDED(hr)) CoUninitialize();
+	 if (InterlockedDecrement(&item->stage->pending)==0) SetEvent(item->stage->done);
+	 return 0;
+	}
+
+	public:
+
+	//! Constructor
+    /*!
+      \param feeds the feeds to calculate; the materials must be set
+      \param nFeeds the number of feeds
+      \param nCompounds the number of compounds
+      \param control the control of the current calculation
+    */
+
+	FeedStage(FeedContribution **feeds,int nFeeds,int nCompounds,CalculationControl *control)
+	{this->feeds=feeds;
+	 this->nFeeds=nFeeds;
+	 this->nCompounds=nCompounds;
+	 this->control=control;
+	 pending=0;
+	 done=NULL;
+	}
+
+	//! Calculate all feed contributions
+    /*!
+      Calculates all feed contributions. If parallel calculation is requested, there
+      is more than one feed and all feed material objects are free-threaded, all but the 
+      first feed are calculated on the system thread pool. If a feed cannot be queued, it 
+      is calculated on the calling thread. This
+      function returns after all feeds have been calculated; the result of each feed is
+      in its ok and error members.
+      \param parallel set to calculate the feeds concurrently
+      \param readOnly set to only read the state of the feeds; the result of each feed is then
+       in its stateRead and error members
+      \sa MaterialAccess
+    */
+
+	template <class W> void Run(bool parallel,bool readOnly=false)
+	{int i;
+	 vector<WorkItem> items;
+	 //the material objects must be callable from the worker threads
+	 for (i=0;(parallel)&&(i<nFeeds);i++)
+	    if (!feeds[i]->material.IsFreeThreaded()) parallel=false;
+	 if ((parallel)&&(nFeeds>1)) done=CreateEvent(NULL,TRUE,FALSE,NULL);
+	 if (!done)
+	    {//sequential
+	     for (i=0;i<nFeeds;i++) Process<W>(feeds[i],readOnly);
+	     return;
+	    }
+	 //queue all but the first feed; the reference count on pending prevents the event from being set before all items are queued
+	 items.resize(nFeeds);
+	 pending=1;
+	 for (i=1;i<nFeeds;i++)
+	    {items[i].stage=this;
+	     items[i].feed=feeds[i];
+	     items[i].readOnly=readOnly;
+	     InterlockedIncrement(&pending);
+	     if (!QueueUserWorkItem(IngestWorker<W>,&items[i],WT_EXECUTEDEFAULT))
+	        {//failed to queue, calculate here
+	         InterlockedDecrement(&pending);
+	         Process<W>(feeds[i],readOnly);
+	        }
+	    }
+	 //first feed on this thread
+	 Process<W>(feeds[0],readOnly);
+	 if (InterlockedDecrement(&pending)!=0) WaitForSingleObject(done,INFINITE);
+	 CloseHandle(done);
+	 done=NULL;
+	}
+
+};
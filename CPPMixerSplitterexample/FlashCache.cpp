@@ -0,0 +1,331 @@
+#include "stdafx.h"
+#include "FlashCache.h"
+#include "ConvergedState.h"
+
+CComAutoCriticalSection FlashCache::lock;
+vector<FlashCache::File> FlashCache::files;
+LONG FlashCache::hits=0;
+LONG FlashCache::misses=0;
+LONG FlashCache::rejected=0;
+LONG FlashCache::stores=0;
+LONG FlashCache::collisions=0;
+
+//! Flash cache file class
+/*!
+  Closes the flash cache files when the module is unloaded
+*/
+
+class FlashCacheFile
+{	public:
+
+	//! Destructor
+    /*!
+      Closes the files
+    */
+
+	~FlashCacheFile()
+	{FlashCache::CloseAll();
+	}
+
+};
+
+static FlashCacheFile flashCacheFile; /*!< the one and only instance, closes the files at module unload */
+
+//! Get the buckets
+/*!
+
+  Opens the file of the tag on first use
+  \param tag the cache tag
+  \return the buckets, or NULL if the cache of the tag is not available
+
+*/
+
+FlashCache::Bucket *FlashCache::GetBuckets(ULONG tag)
+{CComCritSecLock<CComAutoCriticalSection> cacheLock(lock);
+ unsigned int i;
+ File file;
+ for (i=0;i<files.size();i++)
+  if (files[i].tag==tag)
+   {if (!files[i].view) return NULL;
+    return (Bucket *)(files[i].view+sizeof(Header));
+   }
+ //first use of this tag
+ file.tag=tag;
+ file.file=INVALID_HANDLE_VALUE;
+ file.mapping=NULL;
+ file.view=NULL;
+ if (!Open(file)) Close(file);
+ files.push_back(file);
+ if (!file.view) return NULL;
+ return (Bucket *)(file.view+sizeof(Header));
+}
+
+//! Open a file
+/*!
+
+  Opens or creates the file of a tag in the temporary folder and maps it into memory. The 
+  process that creates the file mapping initializes the file if it has a different layout, 
+  and releases buckets that were left claimed by terminated processes; opening is serialized
+  between processes by a named mutex. Must be called with the lock held.
+  \param file the file to open; its tag is set
+  \return true if the file was opened; on failure the caller calls Close()
+
+*/
+
+bool FlashCache::Open(File &file)
+{OLECHAR path[MAX_PATH+1],name[64];
+ DWORD length,size;
+ HANDLE mutex;
+ bool first;
+ int i;
+ //path in the temporary folder
+ swprintf_s(name,64,FLASHCACHEFILENAME,file.tag);
+ length=GetTempPathW(MAX_PATH+1,path);
+ if ((length==0)||(length+wcslen(name)>MAX_PATH)) return false;
+ wcscat_s(path,MAX_PATH+1,name);
+ size=sizeof(Header)+FLASHCACHEBUCKETS*sizeof(Bucket);
+ //serialize opening between processes
+ swprintf_s(name,64,FLASHCACHEMUTEXNAME,file.tag);
+ mutex=CreateMutexW(NULL,FALSE,name);
+ if (!mutex) return false;
+ WaitForSingleObject(mutex,INFINITE); //also returns if another process terminated while holding the mutex
+ file.file=CreateFileW(path,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ|FILE_SHARE_WRITE,NULL,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+ if (file.file!=INVALID_HANDLE_VALUE)
+  {//the mapping extends the file if needed; a new file is zero
+   swprintf_s(name,64,FLASHCACHEMAPPINGNAME,file.tag);
+   file.mapping=CreateFileMappingW(file.file,NULL,PAGE_READWRITE,0,size,name);
+   first=(GetLastError()!=ERROR_ALREADY_EXISTS);
+   if (file.mapping) file.view=(BYTE *)MapViewOfFile(file.mapping,FILE_MAP_ALL_ACCESS,0,0,size);
+   if ((file.view)&&(first))
+    {//no other process has the cache open
+     BYTE *view=file.view;
+     Header *header=(Header *)view;
+     Bucket *buckets=(Bucket *)(view+sizeof(Header));
+     if ((header->version!=FLASHCACHEVERSION)||(header->bucketCount!=FLASHCACHEBUCKETS)||
+         (header->maxCompounds!=FLASHCACHEMAXCOMPOUNDS)||(header->bucketSize!=sizeof(Bucket)))
+      {//new file, or different layout
+       memset(view,0,size);
+       header->version=FLASHCACHEVERSION;
+       header->bucketCount=FLASHCACHEBUCKETS;
+       header->maxCompounds=FLASHCACHEMAXCOMPOUNDS;
+       header->bucketSize=sizeof(Bucket);
+      }
+     else
+      {//release buckets of processes that terminated while writing; their content is not valid
+       for (i=0;i<FLASHCACHEBUCKETS;i++)
+        if (buckets[i].sequence&1)
+         {buckets[i].key.hash=0;
+          buckets[i].sequence++;
+         }
+      }
+    }
+  }
+ ReleaseMutex(mutex);
+ CloseHandle(mutex);
+ return (file.view!=NULL);
+}
+
+//! Close a file
+/*!
+
+  Unmaps and closes the file; the content is kept for subsequent runs. Must be called
+  with the lock held, or at module unload.
+  \param file the file to close
+
+*/
+
+void FlashCache::Close(File &file)
+{if (file.view)
+  {UnmapViewOfFile(file.view);
+   file.view=NULL;
+  }
+ if (file.mapping)
+  {CloseHandle(file.mapping);
+   file.mapping=NULL;
+  }
+ if (file.file!=INVALID_HANDLE_VALUE)
+  {CloseHandle(file.file);
+   file.file=INVALID_HANDLE_VALUE;
+  }
+}
+
+//! Close all files
+/*!
+
+  Called at module unload
+
+*/
+
+void FlashCache::CloseAll()
+{unsigned int i;
+ for (i=0;i<files.size();i++) Close(files[i]);
+ files.clear();
+}
+
+//! Make the key of a flash result
+/*!
+
+  \param tag the cache tag
+  \param identity identity of the property package
+  \param P pressure [Pa]
+  \param H molar enthalpy [J/mol]
+  \param composition overall composition [mol/mol]
+  \param key receives the key
+  \return false if the flash cannot be cached
+
+*/
+
+bool FlashCache::MakeKey(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,Key &key)
+{int i;
+ double x;
+ if (composition.GetCount()>FLASHCACHEMAXCOMPOUNDS) return false;
+ if ((!_finite(P))||(!_finite(H))) return false;
+ memset(&key,0,sizeof(Key)); //the hash covers the unused compositions as well
+ key.identity=identity;
+ key.tag=tag;
+ key.compoundCount=composition.GetCount();
+ key.pressure=(LONGLONG)floor(P/FLASHCACHEPRESSUREQUANTUM+0.5);
+ key.enthalpy=(LONGLONG)floor(H/FLASHCACHEENTHALPYQUANTUM+0.5);
+ for (i=0;i<composition.GetCount();i++)
+  {x=composition.GetDoubleAt(i);
+   if (!_finite(x)) return false;
+   key.composition[i]=(LONGLONG)floor(x/FLASHCACHEFRACTIONQUANTUM+0.5);
+  }
+ key.hash=14695981039346656037ui64; //FNV offset basis
+ ConvergedState::Hash(key.hash,&key.identity,sizeof(Key)-sizeof(ULONGLONG)); //all members following the hash
+ if (!key.hash) key.hash=1; //zero marks an empty bucket
+ return true;
+}
+
+//! Compare keys
+/*!
+
+  \param key1 first key
+  \param key2 second key
+  \return true if the keys are the same
+
+*/
+
+bool FlashCache::SameKey(const Key &key1,const Key &key2)
+{int i;
+ if ((key1.hash!=key2.hash)||(key1.identity!=key2.identity)||(key1.tag!=key2.tag)) return false;
+ if ((key1.compoundCount!=key2.compoundCount)||(key1.pressure!=key2.pressure)||(key1.enthalpy!=key2.enthalpy)) return false;
+ for (i=0;i<key1.compoundCount;i++)
+  if (key1.composition[i]!=key2.composition[i]) return false;
+ return true;
+}
+
+//! Find a flash result
+/*!
+
+  Looks up the temperature of a PH flash, without locking. The caller verifies the
+  result, and calls Reject() if it does not apply.
+  \param tag the cache tag
+  \param identity identity of the property package
+  \param P pressure [Pa]
+  \param H molar enthalpy [J/mol]
+  \param composition overall composition [mol/mol]
+  \param T receives the temperature [K]
+  \return true if a flash result was found
+  \sa Store(), Reject()
+
+*/
+
+bool FlashCache::Find(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,double &T)
+{Key key,stored;
+ Bucket *buckets,*bucket;
+ LONG sequence;
+ double temperature;
+ if (!MakeKey(tag,identity,P,H,composition,key)) return false;
+ buckets=GetBuckets(tag);
+ if (!buckets) return false;
+ bucket=buckets+(key.hash%FLASHCACHEBUCKETS);
+ //copy the bucket; the copy is valid if no writer was active during the copy
+ sequence=bucket->sequence;
+ MemoryBarrier();
+ memcpy(&stored,(const void *)&bucket->key,sizeof(Key));
+ temperature=bucket->temperature;
+ MemoryBarrier();
+ if ((sequence&1)||(bucket->sequence!=sequence)||(!SameKey(key,stored)))
+  {InterlockedIncrement(&misses);
+   return false;
+  }
+ InterlockedIncrement(&hits);
+ T=temperature;
+ return true;
+}
+
+//! Reject a flash result
+/*!
+
+  Counts the last result of Find() as a miss, because the caller found that it does not 
+  apply to its property package. The caller performs the flash and stores its result.
+  \sa Find()
+
+*/
+
+void FlashCache::Reject()
+{InterlockedDecrement(&hits);
+ InterlockedIncrement(&misses);
+ InterlockedIncrement(&rejected);
+}
+
+//! Store a flash result
+/*!
+
+  Stores the temperature of a PH flash, replacing the previous result in its bucket.
+  If another thread or process is writing the bucket, the result is not stored.
+  \param tag the cache tag
+  \param identity identity of the property package
+  \param P pressure [Pa]
+  \param H molar enthalpy [J/mol]
+  \param composition overall composition [mol/mol]
+  \param T temperature [K]
+  \sa Find()
+
+*/
+
+void FlashCache::Store(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,double T)
+{Key key;
+ Bucket *buckets,*bucket;
+ LONG sequence;
+ if (!MakeKey(tag,identity,P,H,composition,key)) return;
+ buckets=GetBuckets(tag);
+ if (!buckets) return;
+ bucket=buckets+(key.hash%FLASHCACHEBUCKETS);
+ //claim the bucket
+ sequence=bucket->sequence;
+ if ((sequence&1)||(InterlockedCompareExchange(&bucket->sequence,sequence+1,sequence)!=sequence))
+  {InterlockedIncrement(&collisions);
+   return;
+  }
+ //write and release
+ memcpy((void *)&bucket->key,&key,sizeof(Key));
+ bucket->temperature=T;
+ MemoryBarrier();
+ InterlockedExchange(&bucket->sequence,sequence+2);
+ InterlockedIncrement(&stores);
+}
+
+//! Get the statistics
+/*!
+
+  Appends the lookups and stores of this process to a report
+  \param report the report to append to
+
+*/
+
+void FlashCache::GetStatistics(wstring &report)
+{OLECHAR buf[256];
+ unsigned int i,unavailable=0;
+ lock.Lock();
+ for (i=0;i<files.size();i++)
+  if (!files[i].view) unavailable++;
+ lock.Unlock();
+ swprintf_s(buf,256,L"Flash cache: %d hits, %d misses, %d rejected, %d stores, %d not stored\r\n",hits,misses,rejected,stores,collisions);
+ report+=buf;
+ if (unavailable)
+  {swprintf_s(buf,256,L"Flash cache: %u tags not available\r\n",unavailable);
+   report+=buf;
+  }
+}
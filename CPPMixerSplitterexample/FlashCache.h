@@ -0,0 +1,131 @@
+#pragma once
+
+#define FLASHCACHEBUCKETS 4096                     /*!< number of buckets of the flash cache; each bucket holds one flash result */
+#define FLASHCACHEMAXCOMPOUNDS 32                  /*!< maximum number of compounds of a cached flash; flashes with more compounds are not cached */
+#define FLASHCACHEPRESSUREQUANTUM 1e-3             /*!< quantum of the pressure in the key of a flash result [Pa] */
+#define FLASHCACHEENTHALPYQUANTUM 1e-3             /*!< quantum of the molar enthalpy in the key of a flash result [J/mol] */
+#define FLASHCACHEFRACTIONQUANTUM 1e-9             /*!< quantum of the mole fractions in the key of a flash result [mol/mol] */
+#define FLASHCACHEENTHALPYTOLERANCE 0.1            /*!< maximum deviation of the enthalpy at a cached temperature from the flash enthalpy [J/mol] */
+#define FLASHCACHEMAXTAG 65535                     /*!< largest cache tag */
+#define FLASHCACHEVERSION 2                        /*!< layout version of the flash cache file */
+#define FLASHCACHEFILENAME L"CPPMixerSplitterFlashCache%u.bin"     /*!< name of the flash cache file of a tag in the temporary folder */
+#define FLASHCACHEMAPPINGNAME L"Local\\CPPMixerSplitterFlashCache%u" /*!< name of the file mapping of a tag shared by the processes */
+#define FLASHCACHEMUTEXNAME L"Local\\CPPMixerSplitterFlashCacheOpen%u" /*!< name of the mutex that serializes opening the flash cache of a tag */
+
+//! Flash cache class
+/*!
+  Cache of PH flash results that is shared by the processes on the machine
+  that use this unit operation with the same cache tag, such as the workers
+  of a case study that calculate the same flowsheet with slightly different
+  inputs. The cache of a tag lives in its own memory-mapped file in the
+  temporary folder, so that it also survives across runs. The tag is chosen
+  by the user, per flowsheet; unit operations that do not set a tag do not
+  use the cache.
+
+  A flash result is keyed on the tag, the identity of the property package
+  and the pressure, molar enthalpy and composition of the flash, quantized
+  by FLASHCACHEPRESSUREQUANTUM, FLASHCACHEENTHALPYQUANTUM and
+  FLASHCACHEFRACTIONQUANTUM. A hit returns the temperature of a flash at
+  inputs that are the same within the quanta.
+
+  CAPE-OPEN does not expose the identity of a property package; as for the
+  ThermoMetadataCache, property packages with the same thermo version,
+  compounds and phases are considered the same. Two property packages with
+  the same compounds and phases but different models would share results,
+  so the caller verifies a hit: the enthalpy at the cached temperature must
+  be the flash enthalpy within FLASHCACHEENTHALPYTOLERANCE, otherwise the
+  hit is rejected with Reject() and the flash is performed.
+
+  The file holds FLASHCACHEBUCKETS buckets; a flash result is stored in the
+  bucket selected by its key, replacing the previous result in that bucket.
+  Each bucket has a sequence number that is odd while the bucket is written.
+  A writer claims a bucket by incrementing an even sequence number with an
+  interlocked compare-exchange, so that each bucket has a single writer; if
+  the claim fails the result is not stored. Readers take no lock: a reader
+  copies the bucket and discards the copy if the sequence number was odd or
+  changed during the copy. A bucket that is left odd by a process that
+  terminated while writing is released by the next process that opens the
+  cache when no other process has it open.
+
+  The file of a tag is opened on first use; if it cannot be opened, the
+  cache of that tag is not available and all lookups miss. All functions
+  are thread-safe.
+*/
+
+class FlashCache
+{
+	//! File header
+	/*!
+	  Identifies the layout of the file; a file with a different layout is reinitialized
+	*/
+
+	struct Header
+	{DWORD version; /*!< FLASHCACHEVERSION */
+	 DWORD bucketCount; /*!< FLASHCACHEBUCKETS */
+	 DWORD maxCompounds; /*!< FLASHCACHEMAXCOMPOUNDS */
+	 DWORD bucketSize; /*!< size of a bucket in bytes */
+	};
+
+	//! Key of a flash result
+	/*!
+	  Identity of the property package and quantized flash inputs
+	*/
+
+	struct Key
+	{ULONGLONG hash; /*!< hash of the other members; selects the bucket */
+	 ULONGLONG identity; /*!< identity of the property package */
+	 ULONGLONG tag; /*!< cache tag */
+	 LONG compoundCount; /*!< number of compounds */
+	 LONGLONG pressure; /*!< quantized pressure */
+	 LONGLONG enthalpy; /*!< quantized molar enthalpy */
+	 LONGLONG composition[FLASHCACHEMAXCOMPOUNDS]; /*!< quantized mole fractions; compoundCount values */
+	};
+
+	//! Bucket
+	/*!
+	  A flash result in the file
+	*/
+
+	struct Bucket
+	{volatile LONG sequence; /*!< odd while the bucket is written */
+	 Key key; /*!< key of the flash result; the hash is zero for an empty bucket */
+	 double temperature; /*!< temperature of the flash result [K] */
+	};
+
+	//! Cache file
+	/*!
+	  The file of a cache tag, opened by this process
+	*/
+
+	struct File
+	{ULONG tag; /*!< the cache tag */
+	 HANDLE file; /*!< the file, or INVALID_HANDLE_VALUE */
+	 HANDLE mapping; /*!< the file mapping, or NULL */
+	 BYTE *view; /*!< the view of the file, or NULL if the cache of this tag is not available */
+	};
+
+	static CComAutoCriticalSection lock; /*!< protects opening and closing the files */
+	static vector<File> files; /*!< files of which opening has been attempted; a tag is not opened again */
+	static LONG hits; /*!< number of lookups that found a flash result */
+	static LONG misses; /*!< number of lookups that did not find a flash result, including rejected hits */
+	static LONG rejected; /*!< number of hits that were rejected by the caller */
+	static LONG stores; /*!< number of stored flash results */
+	static LONG collisions; /*!< number of flash results that were not stored because the bucket was being written */
+
+	friend class FlashCacheFile;
+
+	static Bucket *GetBuckets(ULONG tag);
+	static bool Open(File &file);
+	static void Close(File &file);
+	static void CloseAll();
+	static bool MakeKey(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,Key &key);
+	static bool SameKey(const Key &key1,const Key &key2);
+
+	public:
+
+	static bool Find(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,double &T);
+	static void Reject();
+	static void Store(ULONG tag,ULONGLONG identity,double P,double H,CVariant &composition,double T);
+	static void GetStatistics(wstring &report);
+
+};
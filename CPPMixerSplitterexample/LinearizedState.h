@@ -0,0 +1,158 @@
+#pragma once
+
+#define LINEARIZATIONTOLERANCE 1e-6  //relative tolerance on pressure, and absolute tolerance on mole fractions, for a linearized temperature update
+#define MAXLINEARIZEDSTEPS 5         //maximum number of consecutive linearized temperature updates; the next calculation performs a PH flash
+#define MINSECANTTEMPERATURESTEP 1e-3 //minimum temperature change between PH flashes [K] for which the heat capacity is updated
+#define MAXLINEARIZATIONERROR 1e-2   //maximum estimated temperature error of an extrapolation [K]; larger errors require a PH flash
+
+//! Linearized state class
+/*!
+  Holds the product state of the last PH flash of the unit operation, along
+  with the heat capacity of the product at that state. If the product
+  enthalpy of a later calculation differs only slightly, at the same
+  pressure and composition, the product temperature is extrapolated as
+  T = T0 + (H - H0) / Cp instead of obtained from a PH flash. This applies
+  to converging recycle loops, where the product enthalpy changes little
+  from one calculation to the next.
+
+  The heat capacity is the secant dH/dT between the last two PH flashes,
+  which is only taken if both have the same present phases; within a phase
+  region this includes the latent heat of a multi-phase product. The error
+  of the extrapolation is estimated from the deviation of the last PH flash
+  from the temperature extrapolated to it; it grows with the square of the
+  enthalpy change. Extrapolation thus requires three PH flashes in the same
+  phase region. An extrapolation is only accepted if the enthalpy change is
+  within the linearization limit of the unit operation and the estimated
+  error is at most MAXLINEARIZATIONERROR.
+
+  Each extrapolation is from the state of the last PH flash, so errors do
+  not accumulate; after MAXLINEARIZEDSTEPS extrapolations a PH flash is
+  performed nevertheless, to update the heat capacity and the error estimate.
+
+  This class is not thread-safe; the unit operation protects it.
+*/
+
+class LinearizedState
+{	public:
+
+	bool valid; /*!< set if this holds the state of a PH flash */
+	double temperature; /*!< product temperature [K] */
+	double pressure; /*!< product pressure [Pa] */
+	double molarEnthalpy; /*!< product molar enthalpy [J/mol] */
+	vector<double> composition; /*!< product composition [mol/mol] */
+	vector<wstring> presentPhases; /*!< labels of the phases present in the product */
+	double heatCapacity; /*!< molar heat capacity of the product [J/mol/K]; zero if unknown */
+	double errorCoefficient; /*!< estimated temperature error per squared enthalpy change [K/(J/mol)^2]; negative if unknown */
+	int steps; /*!< number of extrapolations since the PH flash */
+
+	//! Constructor
+    /*!
+      Creates an empty state
+    */
+
+	LinearizedState()
+	{valid=false;
+	 temperature=pressure=molarEnthalpy=heatCapacity=0;
+	 errorCoefficient=-1;
+	 steps=0;
+	}
+
+	//! Extrapolate the product temperature
+    /*!
+      Calculates the product temperature without a PH flash, if the flash inputs are close to
+      the state of the last PH flash. Counts the extrapolation.
+      \param P pressure [Pa]
+      \param H molar enthalpy [J/mol]
+      \param composition overall composition [mol/mol]
+      \param maxDeltaH maximum change in molar enthalpy [J/mol]
+      \param T receives the temperature [K]
+      \param error receives the estimated error of the temperature [K]
+      \return true if the temperature was extrapolated; false if a PH flash is required, including if
+       the estimated error exceeds MAXLINEARIZATIONERROR
+    */
+
+	bool Extrapolate(double P,double H,CVariant &composition,double maxDeltaH,double &T,double &error)
+	{double deltaH=H-molarEnthalpy; //[J/mol]
+	 if ((!valid)||(heatCapacity<=0)||(errorCoefficient<0)) return false;
+	 if (steps>=MAXLINEARIZEDSTEPS) return false;
+	 if (fabs(deltaH)>maxDeltaH) return false;
+	 if (!SameState(P,composition)) return false;
+	 error=errorCoefficient*deltaH*deltaH; //[K]=[K/(J/mol)^2]*[(J/mol)^2]
+	 if (error>MAXLINEARIZATIONERROR) return false; //the product would not close the energy balance
+	 T=temperature+deltaH/heatCapacity; //[K]=[K]+[J/mol]/[J/mol/K]
+	 steps++;
+	 return true;
+	}
+
+	//! Check whether the present phases are those of the PH flash
+    /*!
+      \param phaseList list of present phases
+      \return true if the same phases are present
+    */
+
+	bool SamePhases(CVariant &phaseList)
+	{unsigned int i;
+	 if ((int)presentPhases.size()!=phaseList.GetCount()) return false;
+	 for (i=0;i<presentPhases.size();i++)
+	    if (!CBSTR::Same(presentPhases[i].c_str(),phaseList.GetStringViewAt(i))) return false;
+	 return true;
+	}
+
+	//! Set the state of a PH flash
+    /*!
+      Stores the result of a PH flash. If the previous PH flash was in the same phase region,
+      at the same pressure and composition, the heat capacity is updated and the error estimate
+      is updated from the deviation of this flash from the extrapolated temperature.
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param H molar enthalpy [J/mol]
+      \param composition overall composition [mol/mol]
+      \param phaseList list of present phases
+    */
+
+	void Set(double T,double P,double H,CVariant &composition,CVariant &phaseList)
+	{int i;
+	 double deltaH=H-molarEnthalpy; //[J/mol]
+	 if ((valid)&&(SameState(P,composition))&&(SamePhases(phaseList)))
+	    {if ((heatCapacity>0)&&(deltaH!=0))
+	        errorCoefficient=fabs(T-temperature-deltaH/heatCapacity)/(deltaH*deltaH);
+	     if (fabs(T-temperature)>=MINSECANTTEMPERATURESTEP) heatCapacity=deltaH/(T-temperature); //[J/mol/K]
+	    }
+	 else
+	    {//different phase region; start over
+	     heatCapacity=0;
+	     errorCoefficient=-1;
+	    }
+	 temperature=T;
+	 pressure=P;
+	 molarEnthalpy=H;
+	 this->composition.resize(composition.GetCount());
+	 for (i=0;i<composition.GetCount();i++) this->composition[i]=composition.GetDoubleAt(i);
+	 presentPhases.resize(phaseList.GetCount());
+	 for (i=0;i<phaseList.GetCount();i++)
+	    {BSTR phase=phaseList.GetStringViewAt(i); //owned by phaseList
+	     presentPhases[i]=(phase)?phase:L"";
+	    }
+	 steps=0;
+	 valid=true;
+	}
+
+	private:
+
+	//! Check pressure and composition
+    /*!
+      \param P pressure [Pa]
+      \param composition overall composition [mol/mol]
+      \return true if pressure and composition are those of the PH flash, within LINEARIZATIONTOLERANCE
+    */
+
+	bool SameState(double P,CVariant &composition)
+	{int i;
+	 if (fabs(P-pressure)>LINEARIZATIONTOLERANCE*pressure) return false;
+	 if ((int)this->composition.size()!=composition.GetCount()) return false;
+	 for (i=0;i<composition.GetCount();i++)
+	    if (fabs(composition.GetDoubleAt(i)-this->composition[i])>LINEARIZATIONTOLERANCE) return false;
+	 return true;
+	}
+
+};
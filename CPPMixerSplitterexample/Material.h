@@ -57,28 +57,64 @@ class Material
       \sa Duplicate()
     */
     
-    Material(Material &other) 
+    Material(const Material &other) 
     {materialObject=other.materialObject;
-     materialObject->AddRef();
+     if (materialObject) materialObject->AddRef();
     }
 
 	//! Assignment
     /*!
       Used for assignment; the resulting class references the same material object as the existing class. 
-      For a new material object, use Duplicate
-      \sa Duplicate()
+      For a new material object, use Duplicate. The argument is taken by reference, so that assignment
+      costs a single AddRef and Release
+      \sa Duplicate(), Swap()
     */
     
-    void operator= (Material other) 
-    {//release current
+    Material &operator= (const Material &other) 
+    {//reference the new one before releasing the current one, in case of self-assignment
+     if (other.materialObject) other.materialObject->AddRef();
      if (materialObject) materialObject->Release();
-     materialObject=NULL;
-     if (other.materialObject)
-      {materialObject=other.materialObject;
-       materialObject->AddRef();
-      }
+     materialObject=other.materialObject;
+     return *this;
+    }
+
+	//! Swap
+    /*!
+      Exchanges the material objects of two materials, without changing reference counts
+      \param other the material to swap with
+    */
+    
+    void Swap(Material &other) 
+    {MaterialObjectWrapper *m=materialObject;
+     materialObject=other.materialObject;
+     other.materialObject=m;
+    }
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1600)
+
+	//! Move constructor
+    /*!
+      Takes over the material object of a temporary, without changing reference counts
+    */
+    
+    Material(Material &&other) 
+    {materialObject=other.materialObject;
+     other.materialObject=NULL;
+    }
+
+	//! Move assignment
+    /*!
+      Takes over the material object of a temporary, such as the return value of 
+      CMaterialPort::GetMaterial(), without changing reference counts
+    */
+    
+    Material &operator= (Material &&other) 
+    {Swap(other); //other releases our current material object
+     return *this;
     }
 
+#endif
+
 	//! Check validity
     /*!
       A Material object must be properly initialized before you can use it. It must be obtained either
@@ -131,6 +167,8 @@ class Material
 	 //create a new material object
 	 MaterialObjectWrapper *MO=materialObject->Duplicate(error);
 	 if (!MO) return false; //fail
+	 //the duplicate uses the same property package
+	 MO->SetMetadata(materialObject->metadata);
 	 //clean up old MO in m
 	 if (m.materialObject) m.materialObject->Release();
 	 //set new
@@ -139,6 +177,51 @@ class Material
 	 return true;
 	}
     
+	//! Get the thermo version
+    /*!
+      \return the CAPE-OPEN thermo version of the material object, 10 or 11
+    */
+
+    int GetThermoVersion()
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->GetThermoVersion();
+    }
+
+	//! Check whether the material can be used on any thread
+    /*!
+      A material whose material object does not aggregate the free-threaded marshaler can 
+      only be used in the apartment in which it was obtained
+      \return true if the material object can be called from any thread
+    */
+
+    bool IsFreeThreaded()
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->IsFreeThreaded();
+    }
+
+	//! Set the metadata
+    /*!
+      Sets the metadata of the property package, which is then used instead of querying
+      the material object. Duplicates of this material share the metadata.
+      \param md the metadata, can be NULL
+      \sa ThermoMetadataCache
+    */
+
+    void SetMetadata(ThermoMetadata *md)
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     materialObject->SetMetadata(md);
+    }
+
+	//! Get the metadata
+    /*!
+      \return the metadata of the property package, NULL if not set
+    */
+
+    ThermoMetadata *GetMetadata()
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->metadata;
+    }
+
 	//! Return list of compound IDs
     /*!
       Get the list of compound IDs on this material object. 
@@ -165,19 +248,48 @@ class Material
      return materialObject->GetSinglePhasePropList(list,error);
     }
         
+	//! Return list of possible phases
+    /*!
+      Get the labels of all phases supported by the material object
+      \param list the list of phase labels; empty for version 1.0 thermo
+      \param error error description in case of failure
+      \return true in case of success
+    */
+    
+    bool GetPhaseList(CVariant &list,wstring &error)
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->GetPhaseList(list,error);
+    }
+
 	//! Get value of an overall property
     /*!
       Obtain value(s) an overall property; 
-      \param propName property identifier
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
 
-    bool GetOverallProperty(const OLECHAR *propName,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)
     {ATLASSERT(materialObject); //class should be instanciated properly
-     return materialObject->GetOverallProperty(propName,basis,value,error);
+     return materialObject->GetOverallProperty(prop,basis,value,error);
+    }
+
+	//! Get value of an overall property, if available
+    /*!
+      Obtain value(s) an overall property that may or may not be set on the material object, without calculating it
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
+      \param value receive the property value(s)
+      \param available receives whether the property is available
+      \param error error description in case of failure
+      \return true in case of success, including the case that the property is not available
+    */
+
+    bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->TryGetOverallProperty(prop,basis,value,available,error);
     }
     
 	//! Get list of present phases
@@ -199,32 +311,32 @@ class Material
       Calculate a single phase property for a given phase. It is assumed that only mixture properties will
       be calculated. Unit operation implementations that calculate multiple properties at the same 
       conditions should modify this function to allow for multiple property calculations in a single call.
-      \param propName name of the property to calculate
-      \param phaseName phase for which to calculate the property
+      \param prop the property to calculate
+      \param phaseName phase for which to calculate the property, a phase label obtained from the material object
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool CalcSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,wstring &error)
+    bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)
     {ATLASSERT(materialObject); //class should be instanciated properly
-     return materialObject->CalcSinglePhaseProperty(propName,phaseName,error);
+     return materialObject->CalcSinglePhaseProperty(prop,phaseName,error);
     }
     
 	//! Get value of a single-phase property
     /*!
       Obtain value(s) a property of a given phase
-      \param propName property identifier
-      \param phaseName phase for which to get the property
-      \param calcType: mixture for mixture properties or NULL for fraction or phaseFraction. Ignored for version 1.1 thermo.
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param phaseName phase for which to get the property, a phase label obtained from the material object
+      \param calcType: KEYWORD_MIXTURE for mixture properties or KEYWORD_NONE for fraction or phaseFraction. Ignored for version 1.1 thermo.
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool GetSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,const OLECHAR *calcType,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)
     {ATLASSERT(materialObject); //class should be instanciated properly
-     return materialObject->GetSinglePhaseProperty(propName,phaseName,calcType,basis,value,error);
+     return materialObject->GetSinglePhaseProperty(prop,phaseName,calcType,basis,value,error);
     }
 
 	//! Get temperature from a PH flash at given P, H and composition
@@ -236,12 +348,13 @@ class Material
       \param H enthalpy [J/mol]
       \param T receives temperature [K]
       \param error error description in case of failure
+      \param estimate previous solution to use as initial estimate, can be NULL
       \return true in case of success
     */
     
-    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error)
+    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate=NULL)
     {ATLASSERT(materialObject); //class should be instanciated properly
-     return materialObject->GetTemperatureFromPHFlash(composition,P,H,T,error);
+     return materialObject->GetTemperatureFromPHFlash(composition,P,H,T,error,estimate);
     }
 
 	//! Specify a material object using composition, T and P
@@ -260,5 +373,34 @@ class Material
      return materialObject->SetFromFlowTPX(composition,flow,T,P,error);
     }
 
+	//! Copy the content of a material at equilibrium
+    /*!
+      Copies the content of a material that is at equilibrium at the required state and sets the
+      total flow, instead of setting the state and performing a flash
+      \param source the material to copy from, using the same property package
+      \param flow total flow [mol/s]
+      \return true if the material was set; false if this is not supported, in which case
+      the caller must use SetFromFlowTPX()
+    */
+    
+    bool CopyFrom(Material &source,double flow)
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     ATLASSERT(source.materialObject);
+     return materialObject->CopyFrom(source.materialObject,flow);
+    }
+
+	//! Set the total flow
+    /*!
+      Sets the total flow of a material at equilibrium, if only the flow changes
+      \param flow total flow [mol/s]
+      \return true if the flow was set; false if this is not supported, in which case
+      the caller must use SetFromFlowTPX()
+    */
+    
+    bool SetTotalFlow(double flow)
+    {ATLASSERT(materialObject); //class should be instanciated properly
+     return materialObject->SetTotalFlow(flow);
+    }
+
 };
 
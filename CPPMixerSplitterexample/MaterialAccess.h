@@ -0,0 +1,190 @@
+#pragma once
+#include "Material.h"
+
+//! Statically dispatched material access
+/*!
+  Calls the functions of a material object wrapper of known type, without 
+  going through the virtual functions of MaterialObjectWrapper. The calls are 
+  qualified with the wrapper class, so that the compiler can inline them.
+
+  The thermo version of all material objects connected to a unit operation is 
+  determined at validation. The calculation is then instantiated for 
+  MaterialAccess<MaterialObject10Wrapper> or MaterialAccess<MaterialObject11Wrapper>; 
+  if the ports are connected to material objects of different versions, the 
+  calculation uses MaterialAccess<MaterialObjectWrapper>, which uses virtual calls.
+
+  This class does not hold a reference to the wrapper; the Material from which
+  it is constructed must remain valid while it is used.
+
+  \sa Material, MaterialObjectWrapper
+*/
+
+template <class W> class MaterialAccess
+{
+	W *wrapper; /*!< the wrapper of the material object, owned by the Material */
+
+	public:
+
+	//! Constructor
+    /*!
+      \param material the material; its wrapper must be of type W
+    */
+
+	MaterialAccess(Material &material)
+	{ATLASSERT(material.IsValid());
+	 wrapper=static_cast<W *>(material.materialObject);
+	 ATLASSERT(material.GetThermoVersion()==wrapper->W::GetThermoVersion()); //the version selected at validation should match
+	}
+
+	//! Get value of an overall property
+    /*!
+      \sa Material::GetOverallProperty()
+    */
+
+	bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)
+	{return wrapper->W::GetOverallProperty(prop,basis,value,error);
+	}
+
+	//! Get value of an overall property, if available
+    /*!
+      \sa Material::TryGetOverallProperty()
+    */
+
+	bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)
+	{return wrapper->W::TryGetOverallProperty(prop,basis,value,available,error);
+	}
+
+	//! Get list of present phases
+    /*!
+      \sa Material::GetListOfPresentPhases()
+    */
+
+	bool GetListOfPresentPhases(CVariant &list,wstring &error)
+	{return wrapper->W::GetListOfPresentPhases(list,error);
+	}
+
+	//! Calculate a single phase property
+    /*!
+      \sa Material::CalcSinglePhaseProperty()
+    */
+
+	bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)
+	{return wrapper->W::CalcSinglePhaseProperty(prop,phaseName,error);
+	}
+
+	//! Get value of a single-phase property
+    /*!
+      \sa Material::GetSinglePhaseProperty()
+    */
+
+	bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)
+	{return wrapper->W::GetSinglePhaseProperty(prop,phaseName,calcType,basis,value,error);
+	}
+
+	//! Get temperature from a PH flash at given P, H and composition
+    /*!
+      \sa Material::GetTemperatureFromPHFlash()
+    */
+
+	bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate=NULL)
+	{return wrapper->W::GetTemperatureFromPHFlash(composition,P,H,T,error,estimate);
+	}
+
+	//! Specify a material object using composition, T and P
+    /*!
+      \sa Material::SetFromFlowTPX()
+    */
+
+	bool SetFromFlowTPX(CVariant &composition,double flow,double T,double P,wstring &error)
+	{return wrapper->W::SetFromFlowTPX(composition,flow,T,P,error);
+	}
+
+	//! Copy the content of a material at equilibrium
+    /*!
+      \sa Material::CopyFrom()
+    */
+
+	bool CopyFrom(Material &source,double flow)
+	{return wrapper->W::CopyFrom(source.materialObject,flow);
+	}
+
+	//! Set the total flow
+    /*!
+      \sa Material::SetTotalFlow()
+    */
+
+	bool SetTotalFlow(double flow)
+	{return wrapper->W::SetTotalFlow(flow);
+	}
+
+};
+
+//! Dynamically dispatched material access
+/*!
+  Used if the material objects connected to the unit operation are of different
+  thermo versions; the calls go through the virtual functions of MaterialObjectWrapper
+  \sa MaterialAccess
+*/
+
+template <> class MaterialAccess<MaterialObjectWrapper>
+{
+	MaterialObjectWrapper *wrapper; /*!< the wrapper of the material object, owned by the Material */
+
+	public:
+
+	//! Constructor
+    /*!
+      \param material the material
+    */
+
+	MaterialAccess(Material &material)
+	{ATLASSERT(material.IsValid());
+	 wrapper=material.materialObject;
+	}
+
+	//! Get value of an overall property
+	bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)
+	{return wrapper->GetOverallProperty(prop,basis,value,error);
+	}
+
+	//! Get value of an overall property, if available
+	bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)
+	{return wrapper->TryGetOverallProperty(prop,basis,value,available,error);
+	}
+
+	//! Get list of present phases
+	bool GetListOfPresentPhases(CVariant &list,wstring &error)
+	{return wrapper->GetListOfPresentPhases(list,error);
+	}
+
+	//! Calculate a single phase property
+	bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)
+	{return wrapper->CalcSinglePhaseProperty(prop,phaseName,error);
+	}
+
+	//! Get value of a single-phase property
+	bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)
+	{return wrapper->GetSinglePhaseProperty(prop,phaseName,calcType,basis,value,error);
+	}
+
+	//! Get temperature from a PH flash at given P, H and composition
+	bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate=NULL)
+	{return wrapper->GetTemperatureFromPHFlash(composition,P,H,T,error,estimate);
+	}
+
+	//! Specify a material object using composition, T and P
+	bool SetFromFlowTPX(CVariant &composition,double flow,double T,double P,wstring &error)
+	{return wrapper->SetFromFlowTPX(composition,flow,T,P,error);
+	}
+
+	//! Copy the content of a material at equilibrium
+	bool CopyFrom(Material &source,double flow)
+	{return wrapper->CopyFrom(source.materialObject,flow);
+	}
+
+	//! Set the total flow
+	bool SetTotalFlow(double flow)
+	{return wrapper->SetTotalFlow(flow);
+	}
+
+};
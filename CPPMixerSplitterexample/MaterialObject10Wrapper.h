@@ -15,6 +15,7 @@
 class MaterialObject10Wrapper : public MaterialObjectWrapper
 {   protected:
     friend class Material;
+    template <class W> friend class MaterialAccess;
 
 	ICapeThermoMaterialObject *mat; /*!< reference to the actual underlying version 1.0 Material Object, which is implemented by the simulation environment */
 
@@ -35,6 +36,24 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     
     ~MaterialObject10Wrapper()
     {mat->Release();
+    }
+
+	//! Get the thermo version
+    /*!
+      \return 10
+    */
+
+    int GetThermoVersion()
+    {return 10;
+    }
+
+	//! Check whether the material object can be called from any thread
+    /*!
+      \return true if the material object aggregates the free-threaded marshaler
+    */
+
+    bool IsFreeThreaded()
+    {return IsAgile(mat);
     }
 
 	//! Get a duplicate material
@@ -49,6 +68,7 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     virtual MaterialObjectWrapper *Duplicate(wstring &error)
     {IDispatch *dup;
      HRESULT hr;
+     CalculationStatistics::CountThermoCall();
      hr=mat->Duplicate(&dup); //creates a new material with copied content
      if (FAILED(hr))
       {error=L"Failed to duplicate material object: ";
@@ -79,6 +99,7 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     {HRESULT hr;
      VARIANT v;
      v.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
      hr=mat->get_ComponentIds(&v);
      if (FAILED(hr))
       {error=L"Failed to get list of compounds from material object: ";
@@ -107,6 +128,7 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     {HRESULT hr;
      VARIANT v;
      v.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
      hr=mat->GetPropList(&v);
      if (FAILED(hr))
       {error=L"Failed to get list of properties from material object: ";
@@ -123,24 +145,39 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      return true;
     }
     
+	//! Return list of possible phases
+    /*!
+      Version 1.0 material objects do not expose a list of possible phases; the 
+      PH flash does not require one
+      \param list receives an empty list
+      \param error error description in case of failure
+      \return true
+    */
+    
+    bool GetPhaseList(CVariant &list,wstring &error)
+    {list.MakeArray(0,VT_BSTR);
+     return true;
+    }
+
 	//! Get value of an overall property
     /*!
       Get a value of an overall property; it is assumed that no mixture or pure properties are 
       requested via this function
-      \param propName property identifier
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
 
-    bool GetOverallProperty(const OLECHAR *propName,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)
     {HRESULT hr;
      VARIANT v,compIds;
-     ATLASSERT(propName!=NULL);
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      v.vt=VT_EMPTY;
      compIds.vt=VT_EMPTY;
-     hr=mat->GetProp(CBSTR(propName),CBSTR(L"overall"),compIds,NULL,CBSTR(basis),&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetProp(propName,ThermoIdentifiers::Name(KEYWORD_OVERALL),compIds,NULL,ThermoIdentifiers::Name(basis),&v);
      if (FAILED(hr))
       {error=L"Failed to get overall property \"";
        error+=propName;
@@ -163,6 +200,24 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      return true;
     }
 
+	//! Get value of an overall property, if available
+    /*!
+      Version 1.0 material objects do not distinguish a property that is not set from other 
+      failures of GetProp, so the property is always reported as not available and the 
+      caller calculates it
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
+      \param value not set
+      \param available receives false
+      \param error not set
+      \return true
+    */
+
+    bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)
+    {available=false;
+     return true;
+    }
+
 	//! Get list of present phases
     /*!
       Get the list of phases currently present on the material object
@@ -176,6 +231,7 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     {HRESULT hr;
      VARIANT v;
      v.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
      hr=mat->get_PhaseIds(&v);
      if (FAILED(hr))
       {error=L"Failed to get list of present phases from material object: ";
@@ -197,14 +253,15 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
       Calculate a single phase property for a given phase. It is assumed that only mixture properties will
       be calculated. Unit operation implementations that calculate multiple properties at the same 
       conditions should modify this function to allow for multiple property calculations in a single call.
-      \param propName name of the property to calculate
-      \param phaseName phase for which to calculate the property
+      \param prop the property to calculate
+      \param phaseName phase for which to calculate the property, a phase label obtained from the material object
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool CalcSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,wstring &error)
+    bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)
     {HRESULT hr;
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      CVariant propList,phaseList;
      //make a list of properties
      propList.MakeArray(1,VT_BSTR);
@@ -212,7 +269,8 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      //make a list of phases
      phaseList.MakeArray(1,VT_BSTR);
      phaseList.AllocStringAt(0,phaseName);
-     hr=mat->CalcProp(propList,phaseList,CBSTR(L"mixture"));
+     CalculationStatistics::CountThermoCall();
+     hr=mat->CalcProp(propList,phaseList,ThermoIdentifiers::Name(KEYWORD_MIXTURE));
      if (FAILED(hr))
       {error=L"Failed to calculate property \"";
        error+=propName;
@@ -230,22 +288,23 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
     /*!
       Obtain value(s) a property of a given phase; it is assumed that no mixture or pure properties are 
       requested via this function
-      \param propName property identifier
-      \param phaseName phase for which to get the property
-      \param calcType: mixture for mixture properties or NULL for fraction or phaseFraction. Ignored for version 1.1 thermo.
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param phaseName phase for which to get the property, a phase label obtained from the material object
+      \param calcType: KEYWORD_MIXTURE for mixture properties or KEYWORD_NONE for fraction or phaseFraction. Ignored for version 1.1 thermo.
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool GetSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,const OLECHAR *calcType,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)
     {HRESULT hr;
      VARIANT v,compIds;
-     ATLASSERT(propName!=NULL);
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      v.vt=VT_EMPTY;
      compIds.vt=VT_EMPTY;
-     hr=mat->GetProp(CBSTR(propName),CBSTR(phaseName),compIds,CBSTR(calcType),CBSTR(basis),&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetProp(propName,phaseName,compIds,ThermoIdentifiers::Name(calcType),ThermoIdentifiers::Name(basis),&v);
      if (FAILED(hr))
       {error=L"Failed to get property \"";
        error+=propName;
@@ -281,18 +340,20 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
       \param H enthalpy [J/mol]
       \param T receives temperature [K]
       \param error error description in case of failure
+      \param estimate previous solution; not used, as version 1.0 thermo has no way of passing an initial estimate to a PH flash
       \return true in case of success
     */
     
-    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error)
+    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate)
     {HRESULT hr;
      VARIANT empty,v;
      CVariant scalar;
      v.vt=empty.vt=VT_EMPTY;
      //set composition
-     CBSTR overall(L"overall");
-     CBSTR mole(L"mole");
-     hr=mat->SetProp(CBSTR(L"fraction"),overall,empty,NULL,mole,composition);
+     BSTR overall=ThermoIdentifiers::Name(KEYWORD_OVERALL);
+     BSTR mole=ThermoIdentifiers::Name(BASIS_MOLE);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_FRACTION),overall,empty,NULL,mole,composition);
      if (FAILED(hr))
       {error=L"Failed to set overall composition on material object: ";
        error+=CO_Error(mat,hr);
@@ -301,7 +362,8 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      //set pressure
      scalar.MakeArray(1,VT_R8);
      scalar.SetDoubleAt(0,P);
-     hr=mat->SetProp(CBSTR(L"pressure"),overall,empty,NULL,NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_PRESSURE),overall,empty,NULL,NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set pressure on material object: ";
        error+=CO_Error(mat,hr);
@@ -309,21 +371,24 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
       }
      //set enthalpy
      scalar.SetDoubleAt(0,H);
-     hr=mat->SetProp(CBSTR(L"enthalpy"),overall,empty,CBSTR(L"mixture"),mole,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_ENTHALPY),overall,empty,ThermoIdentifiers::Name(KEYWORD_MIXTURE),mole,scalar);
      if (FAILED(hr))
       {error=L"Failed to set overall enthalpy on material object: ";
        error+=CO_Error(mat,hr);
        return false;
       }
      //perform PH flash
-     hr=mat->CalcEquilibrium(CBSTR(L"PH"),empty);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->CalcEquilibrium(ThermoIdentifiers::Name(KEYWORD_PH),empty);
      if (FAILED(hr))
       {error=L"PH flash calculation failed: ";
        error+=CO_Error(mat,hr);
        return false;
       }
      //get temperature
-     hr=mat->GetProp(CBSTR(L"temperature"),overall,empty,NULL,NULL,&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetProp(ThermoIdentifiers::Name(PROPERTY_TEMPERATURE),overall,empty,NULL,NULL,&v);
      if (FAILED(hr))
       {error=L"Failed to obtain temperature after PH flash: ";
        error+=CO_Error(mat,hr);
@@ -357,9 +422,10 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      CVariant scalar;
      v.vt=empty.vt=VT_EMPTY;
      //set composition
-     CBSTR overall(L"overall");
-     CBSTR mole(L"mole");
-     hr=mat->SetProp(CBSTR(L"fraction"),overall,empty,NULL,mole,composition);
+     BSTR overall=ThermoIdentifiers::Name(KEYWORD_OVERALL);
+     BSTR mole=ThermoIdentifiers::Name(BASIS_MOLE);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_FRACTION),overall,empty,NULL,mole,composition);
      if (FAILED(hr))
       {error=L"Failed to set overall composition on material object: ";
        error+=CO_Error(mat,hr);
@@ -368,7 +434,8 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      //set flow
      scalar.MakeArray(1,VT_R8);
      scalar.SetDoubleAt(0,flow);
-     hr=mat->SetProp(CBSTR(L"totalFlow"),overall,empty,NULL,mole,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_TOTALFLOW),overall,empty,NULL,mole,scalar);
      if (FAILED(hr))
       {error=L"Failed to set total flow on material object: ";
        error+=CO_Error(mat,hr);
@@ -376,7 +443,8 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
       }
      //set temperature
      scalar.SetDoubleAt(0,T);
-     hr=mat->SetProp(CBSTR(L"temperature"),overall,empty,NULL,NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_TEMPERATURE),overall,empty,NULL,NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set temperature on material object: ";
        error+=CO_Error(mat,hr);
@@ -384,14 +452,16 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
       }
      //set pressure
      scalar.SetDoubleAt(0,P);
-     hr=mat->SetProp(CBSTR(L"pressure"),overall,empty,NULL,NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_PRESSURE),overall,empty,NULL,NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set pressure on material object: ";
        error+=CO_Error(mat,hr);
        return false;
       }
      //perform TP flash
-     hr=mat->CalcEquilibrium(CBSTR(L"TP"),empty);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->CalcEquilibrium(ThermoIdentifiers::Name(KEYWORD_TP),empty);
      if (FAILED(hr))
       {error=L"TP flash calculation failed: ";
        error+=CO_Error(mat,hr);
@@ -401,4 +471,38 @@ class MaterialObject10Wrapper : public MaterialObjectWrapper
      return true;
     }
 
+	//! Copy the content of a material at equilibrium
+    /*!
+      Version 1.0 material objects cannot copy the content of another material object into an 
+      existing material object, and the phase equilibrium cannot be transferred by setting 
+      properties; the caller uses SetFromFlowTPX()
+      \param source the material object to copy from
+      \param flow total flow [mol/s]
+      \return false
+    */
+
+    bool CopyFrom(MaterialObjectWrapper *source,double flow)
+    {return false;
+    }
+
+	//! Set the total flow
+    /*!
+      Sets the overall total flow; the phase fractions and phase compositions of the
+      material object are not affected
+      \param flow total flow [mol/s]
+      \return true if the total flow was set
+    */
+
+    bool SetTotalFlow(double flow)
+    {HRESULT hr;
+     VARIANT empty;
+     CVariant scalar;
+     empty.vt=VT_EMPTY;
+     scalar.MakeArray(1,VT_R8);
+     scalar.SetDoubleAt(0,flow);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetProp(ThermoIdentifiers::Name(PROPERTY_TOTALFLOW),ThermoIdentifiers::Name(KEYWORD_OVERALL),empty,NULL,ThermoIdentifiers::Name(BASIS_MOLE),scalar);
+     return SUCCEEDED(hr);
+    }
+
 };
\ No newline at end of file
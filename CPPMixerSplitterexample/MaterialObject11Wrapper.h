@@ -14,6 +14,7 @@
 class MaterialObject11Wrapper : public MaterialObjectWrapper
 {   protected:
     friend class Material;
+    template <class W> friend class MaterialAccess;
 
 	ICapeThermoMaterial *mat; /*!< reference to the actual underlying version 1.1 Material Object, which is implemented by the simulation environment */
 	ICapeThermoPropertyRoutine *iPropRoutine; /*!< reference to the actual underlying version 1.1 Material Object, which is implemented by the simulation environment */
@@ -48,6 +49,24 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      if (iPhases) iPhases->Release();
     }
 
+	//! Get the thermo version
+    /*!
+      \return 11
+    */
+
+    int GetThermoVersion()
+    {return 11;
+    }
+
+	//! Check whether the material object can be called from any thread
+    /*!
+      \return true if the material object aggregates the free-threaded marshaler
+    */
+
+    bool IsFreeThreaded()
+    {return IsAgile(mat);
+    }
+
 	//! Get a duplicate material
     /*!
       Get a duplicate material. Material objects connected to feed ports
@@ -60,6 +79,7 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
     virtual MaterialObjectWrapper *Duplicate(wstring &error)
     {IDispatch *disp;
      HRESULT hr;
+     CalculationStatistics::CountThermoCall();
      hr=mat->CreateMaterial(&disp); //creates a new material without copied content
      if (FAILED(hr))
       {error=L"Failed to create duplicate material object: ";
@@ -75,6 +95,7 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //copy the content
      disp=mat;
+     CalculationStatistics::CountThermoCall();
      hr=dupMat->CopyFromMaterial(&disp);
      if (FAILED(hr))
       {error=L"Failed to copy content to duplicate material object: ";
@@ -107,6 +128,7 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
          return false;
         }
       }
+     CalculationStatistics::CountThermoCall();
      hr=iCompounds->GetCompoundList(&compIds,&formulae,&names,&boilTemps,&molwts,&casnos);
      if (FAILED(hr))
       {error=L"Failed to get list of compounds from material object: ";
@@ -149,6 +171,7 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
          return false;
         }
       }
+     CalculationStatistics::CountThermoCall();
      hr=iPropRoutine->GetSinglePhasePropList(&v);
      if (FAILED(hr))
       {error=L"Failed to get list of properties from material object: ";
@@ -165,24 +188,116 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      return true;
     }
     
+	//! Return list of possible phases
+    /*!
+      Get the labels of all phases that are supported by the material object
+      \param list the list of phase labels
+      \param error error description in case of failure
+      \return true in case of success
+    */
+    
+    bool GetPhaseList(CVariant &list,wstring &error)
+    {HRESULT hr;
+     VARIANT phaseList,aggState,keyComps;
+     //get ICapeThermoPhases interface
+     if (!iPhases) 
+      {hr=mat->QueryInterface(IID_ICapeThermoPhases,(LPVOID*)&iPhases);
+       if (FAILED(hr))
+        {error=L"Material object does not expose ICapeThermoPhases";
+         return false;
+        }
+      }
+     phaseList.vt=aggState.vt=keyComps.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
+     hr=iPhases->GetPhaseList(&phaseList,&aggState,&keyComps);
+     if (FAILED(hr))
+      {error=L"Failed to get list of possible phases from material object: ";
+       error+=CO_Error(mat,hr);
+       return false;
+      }
+     //ignore aggregation states and key compounds
+     VariantClear(&aggState);
+     VariantClear(&keyComps);
+     //check phase list
+     list.Set(phaseList,TRUE); //must be destroyed when done
+     if (!list.CheckArray(VT_BSTR,error))
+      {error=L"Invalid list of possible phases from material object: "+error;
+       return false;
+      }
+     //all ok
+     return true;
+    }
+
+	//! Set all phases present
+    /*!
+      Set all possible phases as present phases, to allow for all phases in the result of a 
+      flash calculation. The list of possible phases is taken from the metadata, if available.
+      Without estimate, the phase status is unknown. With estimate, phases that were present 
+      in the estimate are marked as estimates; if the material object does not accept this,
+      the phase status is set to unknown
+      \param error error description in case of failure
+      \param estimate previous solution, can be NULL
+      \return true in case of success
+    */
+    
+    bool SetAllPhasesPresent(wstring &error,const ConvergedState *estimate=NULL)
+    {HRESULT hr;
+     int i;
+     CVariant phaseList;
+     VARIANT phaseLabels;
+     if (metadata) phaseLabels=metadata->phaseLabels;
+     else
+      {if (!GetPhaseList(phaseList,error)) return false;
+       phaseLabels=phaseList;
+      }
+     if (estimate)
+      {//mark the phases that were present as estimates
+       CVariant labels(phaseLabels,FALSE); //not owned
+       CVariant phaseStatus;
+       labels.CheckArray(VT_BSTR,error); //sets the count; checked before
+       phaseStatus.MakeArray(labels.GetCount(),VT_I4);
+       for (i=0;i<labels.GetCount();i++) 
+        phaseStatus.SetLongAt(i,(estimate->IsPresent(labels.GetStringViewAt(i)))?CAPE_ESTIMATES:CAPE_UNKNOWNPHASESTATUS);
+       CalculationStatistics::CountThermoCall();
+       hr=mat->SetPresentPhases(phaseLabels,phaseStatus);
+       if (SUCCEEDED(hr)) return true;
+      }
+     CalculationStatistics::CountThermoCall();
+     if (metadata) hr=mat->SetPresentPhases(phaseLabels,metadata->phaseStatus);
+     else
+      {CVariant phaseStatus;
+       phaseStatus.MakeArray(phaseList.GetCount(),VT_I4);
+       for (i=0;i<phaseList.GetCount();i++) phaseStatus.SetLongAt(i,CAPE_UNKNOWNPHASESTATUS); //we do not have an initial guess
+       hr=mat->SetPresentPhases(phaseLabels,phaseStatus);
+      }
+     if (FAILED(hr))
+      {error=L"Failed to set list of present phases on material object: ";
+       error+=CO_Error(mat,hr);
+       return false;
+      }
+     //all ok
+     return true;
+    }
+
 	//! Get value of an overall property
     /*!
       Get a value of an overall property; it is assumed that no mixture or pure properties are 
       requested via this function
-      \param propName property identifier
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
 
-    bool GetOverallProperty(const OLECHAR *propName,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)
     {HRESULT hr;
      VARIANT v,compIds;
-     ATLASSERT(propName!=NULL);
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      v.vt=VT_EMPTY;
      compIds.vt=VT_EMPTY;
-     hr=mat->GetOverallProp(CBSTR(propName),CBSTR(basis),&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetOverallProp(propName,ThermoIdentifiers::Name(basis),&v);
      if (FAILED(hr))
       {error=L"Failed to get overall property \"";
        error+=propName;
@@ -204,6 +319,50 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      //all ok
      return true;
     }
+
+	//! Get value of an overall property, if available
+    /*!
+      Get a value of an overall property that may or may not be set on the material object, 
+      such as the overall enthalpy of a material object that results from a flash calculation.
+      The property is not available if the material object returns ECapeThrmPropertyNotAvailableHR;
+      other failures are errors
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
+      \param value receive the property value(s)
+      \param available receives whether the property is available
+      \param error error description in case of failure
+      \return true in case of success, including the case that the property is not available
+    */
+
+    bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)
+    {HRESULT hr;
+     VARIANT v;
+     available=false;
+     v.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetOverallProp(ThermoIdentifiers::Name(prop),ThermoIdentifiers::Name(basis),&v);
+     if (hr==ECapeThrmPropertyNotAvailableHR) return true;
+     if (FAILED(hr))
+      {error=L"Failed to get overall property \"";
+       error+=ThermoIdentifiers::Name(prop);
+       error+=L"\" from material object: ";
+       error+=CO_Error(mat,hr);
+       return false;
+      }
+     //check result
+     value.Set(v,TRUE); //must be destroyed
+     if (!value.CheckArray(VT_R8,error))
+      {wstring s; 
+       s=L"Invalid property value for overall property \"";
+       s+=ThermoIdentifiers::Name(prop);
+       s+=L"\" from material object: ";
+       s+=error;
+       error=s;
+       return false;
+      }
+     available=true;
+     return true;
+    }
     
 	//! Get list of present phases
     /*!
@@ -219,6 +378,7 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      VARIANT phases,status;
      phases.vt=VT_EMPTY;
      status.vt=VT_EMPTY;
+     CalculationStatistics::CountThermoCall();
      hr=mat->GetPresentPhases(&phases,&status);
      if (FAILED(hr))
       {error=L"Failed to get list of present phases from material object: ";
@@ -242,14 +402,15 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       Calculate a single phase property for a given phase. It is assumed that only mixture properties will
       be calculated. Unit operation implementations that calculate multiple properties at the same 
       conditions should modify this function to allow for multiple property calculations in a single call.
-      \param propName name of the property to calculate
-      \param phaseName phase for which to calculate the property
+      \param prop the property to calculate
+      \param phaseName phase for which to calculate the property, a phase label obtained from the material object
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool CalcSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,wstring &error)
+    bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)
     {HRESULT hr;
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      CVariant propList;
      //get IPropertyRoutine interface
      if (!iPropRoutine) 
@@ -262,7 +423,8 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      //make a list of properties
      propList.MakeArray(1,VT_BSTR);
      propList.AllocStringAt(0,propName);
-     hr=iPropRoutine->CalcSinglePhaseProp(propList,CBSTR(phaseName));
+     CalculationStatistics::CountThermoCall();
+     hr=iPropRoutine->CalcSinglePhaseProp(propList,phaseName);
      if (FAILED(hr))
       {error=L"Failed to calculate property \"";
        error+=propName;
@@ -279,22 +441,23 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
 	//! Get value of a single-phase property
     /*!
       Obtain value(s) a property of a given phase
-      \param propName property identifier
-      \param phaseName phase for which to get the property
-      \param calcType: mixture for mixture properties or NULL for fraction or phaseFraction. Ignored for version 1.1 thermo.
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param phaseName phase for which to get the property, a phase label obtained from the material object
+      \param calcType: KEYWORD_MIXTURE for mixture properties or KEYWORD_NONE for fraction or phaseFraction. Ignored for version 1.1 thermo.
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
     
-    bool GetSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,const OLECHAR *calcType,const OLECHAR *basis,CVariant &value,wstring &error)
+    bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)
     {HRESULT hr;
      VARIANT v,compIds;
-     ATLASSERT(propName!=NULL);
+     BSTR propName=ThermoIdentifiers::Name(prop); //not allocated
      v.vt=VT_EMPTY;
      compIds.vt=VT_EMPTY;
-     hr=mat->GetSinglePhaseProp(CBSTR(propName),CBSTR(phaseName),CBSTR(basis),&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetSinglePhaseProp(propName,phaseName,ThermoIdentifiers::Name(basis),&v);
      if (FAILED(hr))
       {error=L"Failed to get property \"";
        error+=propName;
@@ -330,18 +493,20 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       \param H enthalpy [J/mol]
       \param T receives temperature [K]
       \param error error description in case of failure
+      \param estimate previous solution to use as initial estimate, can be NULL. The temperature is set
+      as estimate, and the phases that were present are marked as estimates
       \return true in case of success
     */
     
-    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error)
+    bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate)
     {HRESULT hr;
-     int i;
-     VARIANT empty,v,phaseList,aggState,keyComps;
+     VARIANT empty,v;
      CVariant scalar;
      v.vt=empty.vt=VT_EMPTY;
      //set composition
-     CBSTR mole(L"mole");
-     hr=mat->SetOverallProp(CBSTR(L"fraction"),mole,composition);
+     BSTR mole=ThermoIdentifiers::Name(BASIS_MOLE);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_FRACTION),mole,composition);
      if (FAILED(hr))
       {error=L"Failed to set overall composition on material object: ";
        error+=CO_Error(mat,hr);
@@ -350,7 +515,8 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      //set pressure
      scalar.MakeArray(1,VT_R8);
      scalar.SetDoubleAt(0,P);
-     hr=mat->SetOverallProp(CBSTR(L"pressure"),NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_PRESSURE),NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set pressure on material object: ";
        error+=CO_Error(mat,hr);
@@ -358,47 +524,20 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //set enthalpy
      scalar.SetDoubleAt(0,H);
-     hr=mat->SetOverallProp(CBSTR(L"enthalpy"),mole,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_ENTHALPY),mole,scalar);
      if (FAILED(hr))
       {error=L"Failed to set overall enthalpy on material object: ";
        error+=CO_Error(mat,hr);
        return false;
       }
-     //we are going to perform a flash that will allow all possible phases as result. 
-     // We need to get a list of all possible phases. Get ICapeThermo Phases interface
-     if (!iPhases) 
-      {hr=mat->QueryInterface(IID_ICapeThermoPhases,(LPVOID*)&iPhases);
-       if (FAILED(hr))
-        {error=L"Material object does not expose ICapeThermoPhases";
-         return false;
-        }
-      }
-     //get the total phase list 
-     phaseList.vt=aggState.vt=keyComps.vt=VT_EMPTY;
-     hr=iPhases->GetPhaseList(&phaseList,&aggState,&keyComps);
-     if (FAILED(hr))
-      {error=L"Failed to get list of possible phases from material object: ";
-       error+=CO_Error(mat,hr);
-       return false;
-      }
-     //ignore aggregation states and key compounds
-     VariantClear(&aggState);
-     VariantClear(&keyComps);
-     //check phase list
-     CVariant phaseLabels(phaseList,TRUE); //must be destroyed when done
-     if (!phaseLabels.CheckArray(VT_BSTR,error))
-      {error=L"Invalid list of possible phases from material object: "+error;
-       return false;
-      }
-     //set present phases on MO
-     CVariant phaseStatus;
-     phaseStatus.MakeArray(phaseLabels.GetCount(),VT_I4);
-     for (i=0;i<phaseLabels.GetCount();i++) phaseStatus.SetLongAt(i,CAPE_UNKNOWNPHASESTATUS); //we do not have an initial guess
-     hr=mat->SetPresentPhases(phaseLabels,phaseStatus);
-     if (FAILED(hr))
-      {error=L"Failed to set list of present phases on material object: "+error;
-       return false;
+     //set the initial estimate, if any; the material object may ignore it
+     if (estimate)
+      {scalar.SetDoubleAt(0,estimate->temperature);
+       mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_TEMPERATURE),NULL,scalar); //failure is not an error, this is only an estimate
       }
+     //we are going to perform a flash that will allow all possible phases as result
+     if (!SetAllPhasesPresent(error,estimate)) return false;
      //the flash is performed by the ICapeThermoEquilibriumRoutine interface
      if (!iEqRoutine) 
       {hr=mat->QueryInterface(IID_ICapeThermoEquilibriumRoutine,(LPVOID*)&iEqRoutine);
@@ -409,26 +548,28 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //generate flash specifications
      CVariant flashSpec1,flashSpec2;
-     CBSTR overall(L"overall");
+     BSTR overall=ThermoIdentifiers::Name(KEYWORD_OVERALL);
      //flash specification 1: overall enthalpy
      flashSpec1.MakeArray(3,VT_BSTR);
-     flashSpec1.AllocStringAt(0,L"enthalpy");
+     flashSpec1.AllocStringAt(0,ThermoIdentifiers::Name(PROPERTY_ENTHALPY));
      flashSpec1.SetStringAt(1,NULL);
      flashSpec1.SetStringAt(2,overall);
      //flash specification 2: overall pressure
      flashSpec2.MakeArray(3,VT_BSTR);
-     flashSpec2.AllocStringAt(0,L"pressure");
+     flashSpec2.AllocStringAt(0,ThermoIdentifiers::Name(PROPERTY_PRESSURE));
      flashSpec2.SetStringAt(1,NULL);
      flashSpec2.SetStringAt(2,overall);
      //perform PH flash
-     hr=iEqRoutine->CalcEquilibrium(flashSpec1,flashSpec2,CBSTR(L"unspecified"));
+     CalculationStatistics::CountThermoCall();
+     hr=iEqRoutine->CalcEquilibrium(flashSpec1,flashSpec2,ThermoIdentifiers::Name(KEYWORD_UNSPECIFIED));
      if (FAILED(hr))
       {error=L"PH flash calculation failed: ";
        error+=CO_Error(mat,hr);
        return false;
       }
      //get temperature
-     hr=mat->GetOverallProp(CBSTR(L"temperature"),NULL,&v);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->GetOverallProp(ThermoIdentifiers::Name(PROPERTY_TEMPERATURE),NULL,&v);
      if (FAILED(hr))
       {error=L"Failed to obtain temperature after PH flash: ";
        error+=CO_Error(mat,hr);
@@ -458,13 +599,13 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
     
     bool SetFromFlowTPX(CVariant &composition,double flow,double T,double P,wstring &error)
     {HRESULT hr;
-     int i;
-     VARIANT empty,v,phaseList,aggState,keyComps;
+     VARIANT empty,v;
      CVariant scalar;
      v.vt=empty.vt=VT_EMPTY;
      //set composition
-     CBSTR mole(L"mole");
-     hr=mat->SetOverallProp(CBSTR(L"fraction"),mole,composition);
+     BSTR mole=ThermoIdentifiers::Name(BASIS_MOLE);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_FRACTION),mole,composition);
      if (FAILED(hr))
       {error=L"Failed to set overall composition on material object: ";
        error+=CO_Error(mat,hr);
@@ -473,7 +614,8 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      //set total flow
      scalar.MakeArray(1,VT_R8);
      scalar.SetDoubleAt(0,flow);
-     hr=mat->SetOverallProp(CBSTR(L"totalFlow"),mole,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_TOTALFLOW),mole,scalar);
      if (FAILED(hr))
       {error=L"Failed to set total flow on material object: ";
        error+=CO_Error(mat,hr);
@@ -481,7 +623,8 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //set temperature
      scalar.SetDoubleAt(0,T);
-     hr=mat->SetOverallProp(CBSTR(L"temperature"),NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_TEMPERATURE),NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set temperature on material object: ";
        error+=CO_Error(mat,hr);
@@ -489,47 +632,15 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //set pressure
      scalar.SetDoubleAt(0,P);
-     hr=mat->SetOverallProp(CBSTR(L"pressure"),NULL,scalar);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_PRESSURE),NULL,scalar);
      if (FAILED(hr))
       {error=L"Failed to set pressure on material object: ";
        error+=CO_Error(mat,hr);
        return false;
       }
-     //we are going to perform a flash that will allow all possible phases as result. 
-     // We need to get a list of all possible phases. Get ICapeThermo Phases interface
-     if (!iPhases) 
-      {hr=mat->QueryInterface(IID_ICapeThermoPhases,(LPVOID*)&iPhases);
-       if (FAILED(hr))
-        {error=L"Material object does not expose ICapeThermoPhases";
-         return false;
-        }
-      }
-     //get the total phase list 
-     phaseList.vt=aggState.vt=keyComps.vt=VT_EMPTY;
-     hr=iPhases->GetPhaseList(&phaseList,&aggState,&keyComps);
-     if (FAILED(hr))
-      {error=L"Failed to get list of possible phases from material object: ";
-       error+=CO_Error(mat,hr);
-       return false;
-      }
-     //ignore aggregation states and key compounds
-     VariantClear(&aggState);
-     VariantClear(&keyComps);
-     //check phase list
-     CVariant phaseLabels(phaseList,TRUE); //must be destroyed when done
-     if (!phaseLabels.CheckArray(VT_BSTR,error))
-      {error=L"Invalid list of possible phases from material object: "+error;
-       return false;
-      }
-     //set present phases on MO
-     CVariant phaseStatus;
-     phaseStatus.MakeArray(phaseLabels.GetCount(),VT_I4);
-     for (i=0;i<phaseLabels.GetCount();i++) phaseStatus.SetLongAt(i,CAPE_UNKNOWNPHASESTATUS); //we do not have an initial guess
-     hr=mat->SetPresentPhases(phaseLabels,phaseStatus);
-     if (FAILED(hr))
-      {error=L"Failed to set list of present phases on material object: "+error;
-       return false;
-      }
+     //we are going to perform a flash that will allow all possible phases as result
+     if (!SetAllPhasesPresent(error)) return false;
      //the flash is performed by the ICapeThermoEquilibriumRoutine interface
      if (!iEqRoutine) 
       {hr=mat->QueryInterface(IID_ICapeThermoEquilibriumRoutine,(LPVOID*)&iEqRoutine);
@@ -540,19 +651,20 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
       }
      //generate flash specifications
      CVariant flashSpec1,flashSpec2;
-     CBSTR overall(L"overall");
+     BSTR overall=ThermoIdentifiers::Name(KEYWORD_OVERALL);
      //flash specification 1: overall temperature
      flashSpec1.MakeArray(3,VT_BSTR);
-     flashSpec1.AllocStringAt(0,L"temperature");
+     flashSpec1.AllocStringAt(0,ThermoIdentifiers::Name(PROPERTY_TEMPERATURE));
      flashSpec1.SetStringAt(1,NULL);
      flashSpec1.SetStringAt(2,overall);
      //flash specification 2: overall pressure
      flashSpec2.MakeArray(3,VT_BSTR);
-     flashSpec2.AllocStringAt(0,L"pressure");
+     flashSpec2.AllocStringAt(0,ThermoIdentifiers::Name(PROPERTY_PRESSURE));
      flashSpec2.SetStringAt(1,NULL);
      flashSpec2.SetStringAt(2,overall);
      //perform TP flash
-     hr=iEqRoutine->CalcEquilibrium(flashSpec1,flashSpec2,CBSTR(L"unspecified"));
+     CalculationStatistics::CountThermoCall();
+     hr=iEqRoutine->CalcEquilibrium(flashSpec1,flashSpec2,ThermoIdentifiers::Name(KEYWORD_UNSPECIFIED));
      if (FAILED(hr))
       {error=L"TP flash calculation failed: ";
        error+=CO_Error(mat,hr);
@@ -562,4 +674,53 @@ class MaterialObject11Wrapper : public MaterialObjectWrapper
      return true;
     }
 
+	//! Copy the content of a material at equilibrium
+    /*!
+      Copies the content of a material object that is at equilibrium at the required state, 
+      including the present phases and the phase compositions, by CopyFromMaterial, and sets
+      the total flow. This replaces the TP flash of SetFromFlowTPX(). The copy is only made
+      if both material objects have the same metadata, so that they are known to use the 
+      same property package.
+      \param source the material object to copy from
+      \param flow total flow [mol/s]
+      \return true if the material object was set; false if the copy is not possible or the 
+      material object rejected it, in which case the caller must use SetFromFlowTPX()
+    */
+
+    bool CopyFrom(MaterialObjectWrapper *source,double flow)
+    {HRESULT hr;
+     IDispatch *disp;
+     CVariant scalar;
+     if ((!metadata)||(GetMetadata(source)!=metadata)) return false; //same metadata implies version 1.1
+     //copy the content
+     disp=static_cast<MaterialObject11Wrapper *>(source)->mat;
+     CalculationStatistics::CountThermoCall();
+     hr=mat->CopyFromMaterial(&disp);
+     if (FAILED(hr)) return false;
+     //rescale to the total flow
+     scalar.MakeArray(1,VT_R8);
+     scalar.SetDoubleAt(0,flow);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_TOTALFLOW),ThermoIdentifiers::Name(BASIS_MOLE),scalar);
+     return SUCCEEDED(hr);
+    }
+
+	//! Set the total flow
+    /*!
+      Sets the overall total flow; the phase fractions and phase compositions of the
+      material object are not affected
+      \param flow total flow [mol/s]
+      \return true if the total flow was set
+    */
+
+    bool SetTotalFlow(double flow)
+    {HRESULT hr;
+     CVariant scalar;
+     scalar.MakeArray(1,VT_R8);
+     scalar.SetDoubleAt(0,flow);
+     CalculationStatistics::CountThermoCall();
+     hr=mat->SetOverallProp(ThermoIdentifiers::Name(PROPERTY_TOTALFLOW),ThermoIdentifiers::Name(BASIS_MOLE),scalar);
+     return SUCCEEDED(hr);
+    }
+
 };
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include "ThermoMetadataCache.h"
+#include "ConvergedState.h"
+#include "PropertyIdentifiers.h"
+#include "CalculationStatistics.h"
 
 //! MaterialObjectWrapper class
 /*!
@@ -16,6 +20,16 @@
   Do not create this object directly; this class is managed via the Material
   class.
   
+  The reference count is maintained with interlocked operations, so that 
+  Material instances referring to the same wrapper can be copied and 
+  destroyed on different threads.
+  
+  The wrapper can hold a reference to the shared metadata of the property
+  package, which is then used instead of querying the material object.
+  
+  The implementations count each call to the material object in the
+  CalculationStatistics.
+  
   \sa Material, MaterialObject10Wrapper, MaterialObject11Wrapper
   
 */
@@ -23,10 +37,12 @@
 class MaterialObjectWrapper
 {   protected:
 
-	int refCount; /*!<  reference count; class will get destroyed if reference count hits zero */
+	volatile LONG refCount; /*!<  reference count; class will get destroyed if reference count hits zero. Only modified by interlocked operations */
+	ThermoMetadata *metadata; /*!< metadata of the property package, can be NULL */
 
 	//this class can call all functions
 	friend class Material;
+	template <class W> friend class MaterialAccess;
 
 	//! Constructor.
     /*!
@@ -35,15 +51,16 @@ class MaterialObjectWrapper
     
     MaterialObjectWrapper()
     {refCount=1;
+     metadata=NULL;
     }
 
 	//! Destructor.
     /*!
-      Does nothing. Is virtual, so that calling delete on a MaterialObjectWrapper properly calls the destuctor of the derived class
+      Releases the metadata, if any. Is virtual, so that calling delete on a MaterialObjectWrapper properly calls the destuctor of the derived class
     */
   
     virtual ~MaterialObjectWrapper() 
-     {
+     {if (metadata) metadata->Release();
      }
 
 	//! increases the reference count.
@@ -53,7 +70,7 @@ class MaterialObjectWrapper
     */
   
     void AddRef() 
-     {refCount++;
+     {InterlockedIncrement(&refCount);
      }
 
 	//! decreases the refernce count.
@@ -63,10 +80,65 @@ class MaterialObjectWrapper
     */
 
     void Release()
-    {refCount--;
-     if (refCount==0) delete this;
+    {if (InterlockedDecrement(&refCount)==0) delete this;
+    }
+
+	//! Set the metadata
+    /*!
+      Sets the metadata of the property package. Must be called before the wrapper is shared between threads.
+      \param md the metadata, can be NULL
+    */
+
+    void SetMetadata(ThermoMetadata *md)
+    {if (md) md->AddRef();
+     if (metadata) metadata->Release();
+     metadata=md;
+    }
+
+	//! Get the metadata of another wrapper
+    /*!
+      \param wrapper the wrapper
+      \return the metadata of the wrapper, can be NULL
+    */
+
+    static ThermoMetadata *GetMetadata(MaterialObjectWrapper *wrapper)
+    {return wrapper->metadata;
+    }
+
+	//! Check whether a COM object can be called from any apartment
+    /*!
+      An object that aggregates the free-threaded marshaler can be called directly from
+      any apartment; a reference to any other object can only be used in the apartment
+      in which it was obtained
+      \param object the object
+      \return true if the object aggregates the free-threaded marshaler
+    */
+
+    static bool IsAgile(IUnknown *object)
+    {IMarshal *marshal;
+     CLSID clsid;
+     HRESULT hr;
+     if (FAILED(object->QueryInterface(IID_IMarshal,(LPVOID*)&marshal))) return false;
+     hr=marshal->GetUnmarshalClass(IID_IUnknown,object,MSHCTX_INPROC,NULL,MSHLFLAGS_NORMAL,&clsid);
+     marshal->Release();
+     return (SUCCEEDED(hr))&&(InlineIsEqualGUID(clsid,CLSID_InProcFreeMarshaler));
     }
 
+	//! Get the thermo version
+    /*!
+      \return the CAPE-OPEN thermo version of the material object, 10 or 11
+    */
+
+    virtual int GetThermoVersion()=0;
+
+	//! Check whether the material object can be called from any thread
+    /*!
+      \return true if the material object aggregates the free-threaded marshaler
+      \sa IsAgile()
+    */
+
+    virtual bool IsFreeThreaded()=0;
+
 	//! Get a duplicate material
     /*!
       Get a duplicate material. Material objects connected to feed ports
@@ -98,17 +170,41 @@ class MaterialObjectWrapper
     
     virtual bool GetSinglePhasePropList(CVariant &list,wstring &error)=0;
 
+	//! Return list of possible phases
+    /*!
+      Get the labels of all phases that are supported by the material object
+      \param list the list of phase labels; empty if the thermo version has no such list
+      \param error error description in case of failure
+      \return true in case of success
+    */
+    
+    virtual bool GetPhaseList(CVariant &list,wstring &error)=0;
+
 	//! Get value of an overall property
     /*!
       Get the list of single phase properties
-      \param propName property identifier
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
 
-    virtual bool GetOverallProperty(const OLECHAR *propName,const OLECHAR *basis,CVariant &value,wstring &error)=0;
+    virtual bool GetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,wstring &error)=0;
+
+	//! Get value of an overall property, if available
+    /*!
+      Get the value of an overall property that may or may not be set on the material object,
+      without calculating it
+      \param prop property identifier
+      \param basis property basis, can be BASIS_UNDEFINED
+      \param value receive the property value(s)
+      \param available receives whether the property is available; value is only set if it is
+      \param error error description in case of failure
+      \return true in case of success, including the case that the property is not available
+    */
+
+    virtual bool TryGetOverallProperty(ThermoProperty prop,ThermoBasis basis,CVariant &value,bool &available,wstring &error)=0;
 
 	//! Get list of present phases
     /*!
@@ -126,28 +222,28 @@ class MaterialObjectWrapper
       Calculate a single phase property for a given phase. It is assumed that only mixture properties will
       be calculated. Unit operation implementations that calculate multiple properties at the same 
       conditions should modify this function to allow for multiple property calculations in a single call.
-      \param propName name of the property to calculate
-      \param phaseName phase for which to calculate the property
+      \param prop the property to calculate
+      \param phaseName phase for which to calculate the property, a phase label obtained from the material object
       \param error error description in case of failure
       \return true in case of success
     */
     
-    virtual bool CalcSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,wstring &error)=0;
+    virtual bool CalcSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,wstring &error)=0;
 
 	//! Get value of a single-phase property
     /*!
       Obtain value(s) a property of a given phase; it is assumed that no mixture or pure properties are 
       requested via this function
-      \param propName property identifier
-      \param phaseName phase for which to get the property
-      \param calcType: mixture for mixture properties or NULL for fraction or phaseFraction. Ignored for version 1.1 thermo.
-      \param basis property basis, can be NULL
+      \param prop property identifier
+      \param phaseName phase for which to get the property, a phase label obtained from the material object
+      \param calcType: KEYWORD_MIXTURE for mixture properties or KEYWORD_NONE for fraction or phaseFraction. Ignored for version 1.1 thermo.
+      \param basis property basis, can be BASIS_UNDEFINED
       \param value receive the property value(s)
       \param error error description in case of failure
       \return true in case of success
     */
     
-    virtual bool GetSinglePhaseProperty(const OLECHAR *propName,const OLECHAR *phaseName,const OLECHAR *calcType,const OLECHAR *basis,CVariant &value,wstring &error)=0;
+    virtual bool GetSinglePhaseProperty(ThermoProperty prop,BSTR phaseName,ThermoKeyword calcType,ThermoBasis basis,CVariant &value,wstring &error)=0;
 
 	//! Get temperature from a PH flash at given P, H and composition
     /*!
@@ -158,10 +254,11 @@ class MaterialObjectWrapper
       \param H enthalpy [J/mol]
       \param T receives temperature [K]
       \param error error description in case of failure
+      \param estimate previous solution to use as initial estimate, can be NULL
       \return true in case of success
     */
     
-    virtual bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error)=0;
+    virtual bool GetTemperatureFromPHFlash(CVariant &composition,double P,double H,double &T,wstring &error,const ConvergedState *estimate)=0;
 
 	//! Specify a material object using composition, T and P
     /*!
@@ -176,5 +273,30 @@ class MaterialObjectWrapper
     
     virtual bool SetFromFlowTPX(CVariant &composition,double flow,double T,double P,wstring &error)=0;
 
+	//! Copy the content of a material at equilibrium
+    /*!
+      Copies the content of a material object that is at equilibrium at the required state, and 
+      sets the total flow; this replaces SetFromFlowTPX() if a material object at the same state
+      is available. Both material objects must use the same property package. 
+      \param source the material object to copy from
+      \param flow total flow [mol/s]
+      \return true if the material object was set; false if the material object does not support 
+      this, in which case the caller must use SetFromFlowTPX()
+    */
+    
+    virtual bool CopyFrom(MaterialObjectWrapper *source,double flow)=0;
+
+	//! Set the total flow
+    /*!
+      Sets the total flow of a material object that is at equilibrium, without changing its 
+      intensive state; this replaces SetFromFlowTPX() if only the flow changes. The phase 
+      equilibrium does not depend on the flow, so no flash is performed.
+      \param flow total flow [mol/s]
+      \return true if the total flow was set; false if the material object rejected it, in 
+      which case the caller must use SetFromFlowTPX()
+    */
+    
+    virtual bool SetTotalFlow(double flow)=0;
+
 };
 
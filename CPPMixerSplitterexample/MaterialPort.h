@@ -5,8 +5,24 @@
 
 #include "CPPMixerSplitterexample.h"
 #include "CAPEOPENBaseObject.h"
+#include "ObjectPool.h"
 #include "Material.h"
+#include "OutletState.h"
+#include "FeedCache.h"
 
+//! Material port specification
+/*!
+  Immutable definition of a material port. Definitions are static tables
+  of the unit operation, so that all instances of the unit operation share
+  the names and descriptions of their ports
+  \sa CMaterialPort::CreateMaterialPort()
+*/
+
+struct MaterialPortSpec
+{const OLECHAR *name;        /*!< name of the port */
+ const OLECHAR *description; /*!< description of the port */
+ CapePortDirection direction; /*!< direction of the port, CAPE_INLET or CAPE_OUTLET */
+};
 
 //! Material port class
 /*!
@@ -21,6 +37,20 @@
   This object implements ICapeUnitPort and derived from 
   CAPEOPENBaseObject for the identification and error
   common interfaces.
+  
+  The connected object is protected by the object lock, so that
+  the simulation environment can connect or disconnect the port
+  while the unit operation is accessing it from another thread.
+  
+  After validation, the port holds the metadata of the property package
+  of the connected material object; materials obtained from the port share
+  this metadata. The metadata is dropped when the connection changes.
+  
+  A product port remembers the values last written to the connected material
+  object, so that the unit operation can leave the material object alone if
+  the product did not change. These values are also dropped when the 
+  connection changes. Similarly, a feed port keeps the enthalpy of the last
+  state of the connected material object.
 */
 
 class ATL_NO_VTABLE CMaterialPort :
@@ -32,25 +62,28 @@ public:
 
 	ICapeThermoMaterialObject *mat10; /*!< the material object connected to this port, if version 1.0 */
 	ICapeThermoMaterial *mat11; /*!< the material object connected to this port, if version 1.1 */
-	CapePortDirection direction; /*!< the direction of the port, CAPE_INLET or CAPE_OUTLET */
+	const MaterialPortSpec *spec; /*!< the immutable definition of this port, shared by all instances of the unit operation */
+	ThermoMetadata *metadata; /*!< metadata of the property package of the connected material object, set by validation; can be NULL */
+	OutletState written; /*!< values last written to the connected material object, for product ports */
+	FeedCache feedCache; /*!< enthalpy of the last state of the connected material object, for feed ports */
+	CapeValidationStatus *valStatus; /*!< points to the unit operation's validation status */
 
 	//! Helper function for creating the material port 
     /*!
       Helper function for creating the material port as an exposable COM object. After calling CreateMaterialPort, the reference
       count is one; do not delete the returned object. Use Release() instead
-      \param name name of the port
-      \param description description of the port
-      \param direction direction of the port
+      \param spec definition of the port; must remain valid during the life time of the port
+      \param valStatus points to the unit operation's validation status
       \sa CMaterialPort()
     */
 
-    static CComObject<CMaterialPort> *CreateMaterialPort(const OLECHAR *name,const OLECHAR *description,CapePortDirection direction)
+    static CComObject<CMaterialPort> *CreateMaterialPort(const MaterialPortSpec *spec,CapeValidationStatus *valStatus)
     {CComObject<CMaterialPort> *p;
      CComObject<CMaterialPort>::CreateInstance(&p); //create the instance with zero references
      p->AddRef(); //now it has one reference, the caller must Release this object
-     p->name=name;
-     p->description=description;
-     p->direction=direction;
+     p->spec=spec;
+     p->valStatus=valStatus;
+     p->SetIdentification(spec->name,spec->description); //no copy is made
      return p;
     }
 
@@ -64,6 +97,8 @@ public:
 	CMaterialPort() : CAPEOPENBaseObject(false)
 	{mat10=NULL;
 	 mat11=NULL;
+	 metadata=NULL;
+	 valStatus=NULL;
 	}
 	
 	//! Destructor.
@@ -80,6 +115,7 @@ public:
       {ATLASSERT(false); //should have been disconnected before
        mat11->Release();
       }
+     if (metadata) metadata->Release();
     }	
 
 	//this object cannot be created using CoCreateInstance, so we do not need to put anything in the registry
@@ -96,6 +132,10 @@ public:
 
 	DECLARE_PROTECT_FINAL_CONSTRUCT()
 
+	//allocate from the object pool, as each unit operation creates many of these objects
+
+	DECLARE_POOLED_ALLOCATION()
+
 	//! IsConnected
     /*!
       Utility function to check whether the port is connected.
@@ -104,9 +144,35 @@ public:
     */
 
     bool IsConnected()
-     {return ((mat10!=NULL)||(mat11!=NULL));
+     {ObjectLock lock(this);
+      return ((mat10!=NULL)||(mat11!=NULL));
      }
 
+	//! Get the thermo version of the connected material object
+    /*!
+      \return 11 for a version 1.1 material object, 10 for a version 1.0 material object, or 0 if not connected
+      \sa Connect()
+    */
+
+    int GetThermoVersion()
+     {ObjectLock lock(this);
+      if (mat11) return 11;
+      if (mat10) return 10;
+      return 0;
+     }
+
+	//! Invalidate the unit operation
+    /*!
+      Sets the validation status of the unit operation to CAPE_NOT_VALIDATED, as the
+      metadata and thermo version selected at validation apply to the connected material
+      object. The status is shared with the unit operation that may be calculating on another
+      thread, so it is changed with an interlocked operation
+    */
+
+    void InvalidateUnit()
+    {InterlockedExchange((volatile LONG*)valStatus,(LONG)CAPE_NOT_VALIDATED);
+    }
+
 	//! Get a MaterialObject class
     /*!
       Get an object to represent the connected material. To the caller it is transparent 
@@ -119,13 +185,135 @@ public:
     */
 
     Material GetMaterial()
-    {ATLASSERT(IsConnected()); //caller should verify that the port is connected before calling this function
-     Material m;
+    {Material m;
+     GetMaterial(m);
+     return m;
+    }	
+
+	//! Get the material object
+    /*!
+      Same as GetMaterial(), but sets an existing Material, avoiding the copy of 
+      the return value.
+      
+      Should only be called if the port is connected (caller should verify).
+      
+      \param material receives the material; the material it referenced before is released
+      \sa GetMaterial()
+    */
+
+    void GetMaterial(Material &material)
+    {Material m;
+     ObjectLock lock(this);
+     ATLASSERT(IsConnected()); //caller should verify that the port is connected before calling this function
      if (mat11) m.SetMaterial11(mat11);
      else m.SetMaterial10(mat10);
-     return m;
+     if (metadata) m.SetMetadata(metadata);
+     material.Swap(m); //the previous material is released with m
     }	
 
+	//! Set the metadata
+    /*!
+      Sets the metadata of the property package of the connected material object; 
+      called by the unit operation at validation. The property package may have 
+      changed without a change of metadata, so the feed cache must be verified again.
+      \param md the metadata, can be NULL
+      \sa ThermoMetadataCache
+    */
+
+    void SetMetadata(ThermoMetadata *md)
+    {ObjectLock lock(this);
+     feedCache.verified=false; //the enthalpy depends on the property package
+     if (md) md->AddRef();
+     if (metadata) metadata->Release();
+     metadata=md;
+    }
+
+	//! Check whether the product is unchanged
+    /*!
+      Checks whether the values are those last written to the connected material object 
+      \param composition overall composition [mol/mol]
+      \param flow total flow [mol/s]
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param tolerance relative tolerance on flow, temperature and pressure, absolute tolerance on mole fractions
+      \return true if the material object already holds these values
+      \sa SetWritten()
+    */
+
+    bool IsWritten(CVariant &composition,double flow,double T,double P,double tolerance)
+    {ObjectLock lock(this);
+     return written.Matches(composition,flow,T,P,tolerance);
+    }
+
+	//! Set the values written to the product
+    /*!
+      Called after the connected material object has been set. Call with a NULL composition
+      before setting the material object, so that the values are not used if this fails.
+      \param composition overall composition [mol/mol], or NULL to forget the values last written
+      \param flow total flow [mol/s]
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \sa IsWritten()
+    */
+
+    void SetWritten(CVariant *composition,double flow=0,double T=0,double P=0)
+    {ObjectLock lock(this);
+     if (composition) written.Set(*composition,flow,T,P);
+     else written.valid=false;
+    }
+
+	//! Check whether the product state is unchanged
+    /*!
+      Checks whether the intensive state is the one last written to the connected material object, 
+      in which case only the flow needs to be written
+      \param composition overall composition [mol/mol]
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param tolerance relative tolerance on temperature and pressure, absolute tolerance on mole fractions
+      \return true if the material object already holds this state
+      \sa SetWrittenFlow()
+    */
+
+    bool IsWrittenState(CVariant &composition,double T,double P,double tolerance)
+    {ObjectLock lock(this);
+     return written.MatchesState(composition,T,P,tolerance);
+    }
+
+	//! Set the flow written to the product
+    /*!
+      Called after only the flow of the connected material object has been set; the values
+      of the intensive state are kept, so that changes within tolerance do not accumulate
+      \param flow total flow [mol/s]
+      \sa IsWrittenState()
+    */
+
+    void SetWrittenFlow(double flow)
+    {ObjectLock lock(this);
+     written.flow=flow;
+    }
+
+	//! Get the feed cache
+    /*!
+      \param cache receives a copy of the cached enthalpy of the last state of the connected material object
+      \sa SetFeedCache()
+    */
+
+    void GetFeedCache(FeedCache &cache)
+    {ObjectLock lock(this);
+     cache=feedCache;
+    }
+
+	//! Set the feed cache
+    /*!
+      \param cache the cached enthalpy of the last state of the connected material object
+      \sa GetFeedCache()
+    */
+
+    void SetFeedCache(const FeedCache &cache)
+    {ObjectLock lock(this);
+     feedCache=cache;
+    }
+
 	// ICapeUnitPort Methods
 
 	//! ICapeUnitPort::get_portType
@@ -149,7 +337,7 @@ public:
 
 	STDMETHOD(get_direction)(CapePortDirection * portDirection)
 	{	if (!portDirection) return E_POINTER; //not a valid pointer
-	    *portDirection=direction;
+	    *portDirection=spec->direction;
 		return NOERROR;
 	}
 
@@ -161,6 +349,7 @@ public:
 
 	STDMETHOD(get_connectedObject)(LPDISPATCH * connectedObject)
 	{	if (!connectedObject) return E_POINTER; //not a valid pointer
+	    ObjectLock lock(this);
 	    if (mat10) 
 	     {*connectedObject=mat10;
 	      mat10->AddRef(); //caller must release
@@ -182,13 +371,14 @@ public:
     /*!
       Return the object connected to this port. The Connect method should check whether the object is an object
       of the type which is supported, and refuse the connection if not. This port accepts material objects 
-      of CAPE-OPEN thermo 1.0 and 1.1 versions
+      of CAPE-OPEN thermo 1.0 and 1.1 versions. The unit operation must be validated again
       \param objectToConnect [in] object to connected to. Cannot be NULL.
       \sa Disconnect()
     */
 
 	STDMETHOD(Connect)(LPDISPATCH objectToConnect)
 	{	if (!objectToConnect) return E_POINTER; //not a valid pointer; use Disconnect instead
+	    ObjectLock lock(this);
 	    //disconnect whatever we have connected now
 	    Disconnect();
 	    //we prefer to use version 1.1 thermo, if available
@@ -202,12 +392,14 @@ public:
 
 	//! ICapeUnitPort::Disconnect
     /*!
-      Release references to the connected object
+      Release references to the connected object. The unit operation must be validated again
       \sa Connect()
     */
 
 	STDMETHOD(Disconnect)()
-	{	if (mat10) 
+	{	ObjectLock lock(this);
+	    InvalidateUnit();
+	    if (mat10) 
 	     {mat10->Release();
 	      mat10=NULL;
 	     }
@@ -215,6 +407,13 @@ public:
 	     {mat11->Release();
 	      mat11=NULL;
 	     }
+	    //metadata and written values apply to the previously connected object
+	    if (metadata)
+	     {metadata->Release();
+	      metadata=NULL;
+	     }
+	    written.valid=false;
+	    feedCache.valid=false;
 		return NOERROR;
 	}
 
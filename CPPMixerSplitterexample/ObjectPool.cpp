@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include "ObjectPool.h"
+
+CComAutoCriticalSection ObjectPool::lock;
+ObjectPool::SizeClass ObjectPool::sizeClasses[POOLSIZECLASSES]; //zero initialized, as static
+LONG ObjectPool::heapAllocationCount=0;
+
+//! Allocate an object
+/*!
+
+  Allocates memory for an object from the size class of the object. 
+  Objects larger than the largest size class are allocated from the heap. 
+  Like the global operator new, this throws in case of out of memory.
+  \param size size of the object in bytes
+  \return the allocated memory
+  \sa Free()
+
+*/
+
+void *ObjectPool::Allocate(size_t size)
+{int i,index;
+ size_t blockSize;
+ BYTE *chunk;
+ FreeBlock *block;
+ if (size==0) size=1;
+ index=(int)((size-1)/POOLGRANULARITY);
+ if (index>=POOLSIZECLASSES)
+  {InterlockedIncrement(&heapAllocationCount);
+   return ::operator new(size);
+  }
+ CComCritSecLock<CComAutoCriticalSection> poolLock(lock);
+ SizeClass &sc=sizeClasses[index];
+ if (!sc.freeList)
+  {//allocate a new chunk and put its blocks on the free list
+   blockSize=(index+1)*POOLGRANULARITY;
+   chunk=new BYTE[blockSize*POOLBLOCKSPERCHUNK]; //never freed; reused by subsequent allocations
+   for (i=POOLBLOCKSPERCHUNK-1;i>=0;i--)
+    {block=(FreeBlock *)(chunk+i*blockSize);
+     block->next=sc.freeList;
+     sc.freeList=block;
+    }
+   sc.chunkCount++;
+  }
+ block=sc.freeList;
+ sc.freeList=block->next;
+ sc.allocationCount++;
+ if (++sc.inUse>sc.peakInUse) sc.peakInUse=sc.inUse;
+ return block;
+}
+
+//! Free an object
+/*!
+
+  Returns the memory of an object to the free list of its size class
+  \param p the memory, obtained from Allocate(); can be NULL
+  \param size size of the object in bytes, as passed to Allocate()
+  \sa Allocate()
+
+*/
+
+void ObjectPool::Free(void *p,size_t size)
+{int index;
+ FreeBlock *block;
+ if (!p) return;
+ if (size==0) size=1;
+ index=(int)((size-1)/POOLGRANULARITY);
+ if (index>=POOLSIZECLASSES)
+  {::operator delete(p);
+   return;
+  }
+ CComCritSecLock<CComAutoCriticalSection> poolLock(lock);
+ SizeClass &sc=sizeClasses[index];
+ ATLASSERT(sc.inUse>0);
+ block=(FreeBlock *)p;
+ block->next=sc.freeList;
+ sc.freeList=block;
+ sc.inUse--;
+}
+
+//! Get allocation statistics
+/*!
+
+  Appends a line for each size class that is in use, with the number of
+  allocations, the number of blocks in use, the peak number of blocks in 
+  use and the number of chunks, followed by the number of heap allocations
+  \param report the text to append to
+
+*/
+
+void ObjectPool::GetStatistics(wstring &report)
+{int i;
+ OLECHAR buf[256];
+ CComCritSecLock<CComAutoCriticalSection> poolLock(lock);
+ for (i=0;i<POOLSIZECLASSES;i++)
+  {SizeClass &sc=sizeClasses[i];
+   if (!sc.chunkCount) continue;
+   swprintf_s(buf,256,L"Object pool, %d byte blocks: %d allocations, %d in use, peak %d, %d chunks\r\n",(i+1)*POOLGRANULARITY,sc.allocationCount,sc.inUse,sc.peakInUse,sc.chunkCount);
+   report+=buf;
+  }
+ swprintf_s(buf,256,L"Object pool, heap allocations: %d\r\n",heapAllocationCount);
+ report+=buf;
+}
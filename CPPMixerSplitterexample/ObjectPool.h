@@ -0,0 +1,73 @@
+#pragma once
+
+#define POOLGRANULARITY 16     /*!< block sizes of the object pool are multiples of this number of bytes */
+#define POOLSIZECLASSES 32     /*!< number of size classes; larger objects are allocated from the heap */
+#define POOLBLOCKSPERCHUNK 64  /*!< number of blocks that are allocated from the heap at once */
+
+//! Object pool class
+/*!
+  Process-wide pool for the COM objects that are created for each unit
+  operation instance: ports, parameters and collections. When a simulation
+  environment creates or destroys many unit operations at once, for example
+  when copying part of a flowsheet, allocating these objects one at a time 
+  from the heap is slow and fragments memory.
+
+  Memory is organized in size classes of POOLGRANULARITY bytes. Each size
+  class keeps a list of free blocks; if the list is empty, a chunk of 
+  POOLBLOCKSPERCHUNK blocks is allocated from the heap. Freed blocks return
+  to the list of their size class; chunks are kept for the life time of the
+  process, so that the memory is reused by the next unit operation.
+
+  Classes use the pool by including DECLARE_POOLED_ALLOCATION() in their
+  declaration; this also applies to the CComObject classes derived from 
+  them. All functions are thread-safe.
+*/
+
+class ObjectPool
+{
+	//! Free block
+	/*!
+	  A block on the free list of a size class
+	*/
+
+	struct FreeBlock
+	{FreeBlock *next; /*!< next free block, or NULL */
+	};
+
+	//! Size class
+	/*!
+	  Free list and statistics of a size class
+	*/
+
+	struct SizeClass
+	{FreeBlock *freeList; /*!< the free blocks */
+	 LONG chunkCount; /*!< number of chunks allocated from the heap */
+	 LONG allocationCount; /*!< total number of allocations */
+	 LONG inUse; /*!< number of blocks currently allocated */
+	 LONG peakInUse; /*!< maximum number of blocks in use */
+	};
+
+	static CComAutoCriticalSection lock; /*!< protects the size classes */
+	static SizeClass sizeClasses[POOLSIZECLASSES]; /*!< the size classes; class i has blocks of (i+1)*POOLGRANULARITY bytes */
+	static LONG heapAllocationCount; /*!< number of allocations that were too large for the pool */
+
+	public:
+
+	static void *Allocate(size_t size);
+	static void Free(void *p,size_t size);
+	static void GetStatistics(wstring &report);
+
+};
+
+//! Use the object pool for a class
+/*!
+  Declares class operators new and delete that allocate from the object pool.
+  The operators are inherited by derived classes, such as CComObject<>; 
+  delete is passed the size of the actual object, as the destructors of 
+  COM objects are virtual
+  \sa ObjectPool
+*/
+
+#define DECLARE_POOLED_ALLOCATION() \
+	static void *operator new(size_t size) {return ObjectPool::Allocate(size);} \
+	static void operator delete(void *p,size_t size) {ObjectPool::Free(p,size);}
@@ -0,0 +1,109 @@
+#pragma once
+
+//! Outlet state class
+/*!
+  Holds the product flow, temperature, pressure and composition that were
+  last written to the material object connected to a product port. If a
+  calculation produces the same values, the material object is not touched,
+  so that the simulation environment can see that the product did not change.
+  If only the flow changed, the intensive state of the product is the same
+  and only the flow needs to be written.
+
+  Flow, temperature and pressure are compared relative to their magnitude,
+  the composition is compared on absolute mole fractions. With a zero
+  tolerance the values must be exactly the same.
+
+  This class is not thread-safe; the port protects it.
+*/
+
+class OutletState
+{	public:
+
+	bool valid; /*!< set if this holds the values last written */
+	double flow; /*!< total flow [mol/s] */
+	double temperature; /*!< temperature [K] */
+	double pressure; /*!< pressure [Pa] */
+	vector<double> composition; /*!< overall composition [mol/mol] */
+
+	//! Constructor
+    /*!
+      Creates an empty state
+    */
+
+	OutletState()
+	{valid=false;
+	 flow=temperature=pressure=0;
+	}
+
+	//! Check whether the state matches new product values
+    /*!
+      \param composition overall composition [mol/mol]
+      \param flow total flow [mol/s]
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param tolerance relative tolerance on flow, temperature and pressure, absolute tolerance on mole fractions
+      \return true if the values are within tolerance of the values last written
+    */
+
+	bool Matches(CVariant &composition,double flow,double T,double P,double tolerance)
+	{if (!MatchesState(composition,T,P,tolerance)) return false;
+	 return Same(flow,this->flow,tolerance);
+	}
+
+	//! Check whether the intensive state matches new product values
+    /*!
+      \param composition overall composition [mol/mol]
+      \param T temperature [K]
+      \param P pressure [Pa]
+      \param tolerance relative tolerance on temperature and pressure, absolute tolerance on mole fractions
+      \return true if the values are within tolerance of the values last written, regardless of the flow
+    */
+
+	bool MatchesState(CVariant &composition,double T,double P,double tolerance)
+	{int i;
+	 if (!valid) return false;
+	 if ((int)this->composition.size()!=composition.GetCount()) return false;
+	 if (!Same(T,temperature,tolerance)) return false;
+	 if (!Same(P,pressure,tolerance)) return false;
+	 for (i=0;i<composition.GetCount();i++)
+	    if (fabs(composition.GetDoubleAt(i)-this->composition[i])>tolerance) return false;
+	 return true;
+	}
+
+	//! Set the state
+    /*!
+      Stores the values written to the product
+      \param composition overall composition [mol/mol]
+      \param flow total flow [mol/s]
+      \param T temperature [K]
+      \param P pressure [Pa]
+    */
+
+	void Set(CVariant &composition,double flow,double T,double P)
+	{int i;
+	 this->flow=flow;
+	 temperature=T;
+	 pressure=P;
+	 this->composition.resize(composition.GetCount());
+	 for (i=0;i<composition.GetCount();i++) this->composition[i]=composition.GetDoubleAt(i);
+	 valid=true;
+	}
+
+	private:
+
+	//! Compare two values
+    /*!
+      \param a first value
+      \param b second value
+      \param tolerance relative tolerance
+      \return true if the values are the same within tolerance
+    */
+
+	static bool Same(double a,double b,double tolerance)
+	{double scale;
+	 if (a==b) return true;
+	 scale=(fabs(a)>fabs(b))?fabs(a):fabs(b);
+	 return (fabs(a-b)<=tolerance*scale);
+	}
+
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+//! Persistence buffer class
+/*!
+  Contiguous buffer for saving and loading the unit operation, so that the
+  stream is accessed by a single Write or Read call rather than by one call
+  per field. Values are appended to the buffer when saving; when loading,
+  values are read from the buffer at the current position. All read
+  functions check that the data is within the buffer and return false if
+  it is not, so that a truncated or corrupt file does not cause reading
+  beyond the buffer.
+
+  The buffer keeps its memory when it is reset, so that it can be reused.
+*/
+
+class PersistBuffer
+{
+	vector<BYTE> data; /*!< the buffer; its size is the capacity in use */
+	UINT size; /*!< number of bytes in the buffer */
+	UINT position; /*!< read position */
+
+	public:
+
+	//! Constructor
+    /*!
+      Creates an empty buffer
+    */
+
+	PersistBuffer()
+	{size=position=0;
+	}
+
+	//! Reset the buffer
+    /*!
+      Empties the buffer, keeping the allocated memory
+      \param newSize number of bytes in the buffer; the content is undefined and
+      can be set with GetData()
+      \sa GetData()
+    */
+
+	void Reset(UINT newSize=0)
+	{if (data.size()<newSize) data.resize(newSize);
+	 size=newSize;
+	 position=0;
+	}
+
+	//! Buffer data
+    /*!
+      \return pointer to the content of the buffer
+    */
+
+	BYTE *GetData()
+	{return (data.empty())?NULL:&data[0];
+	}
+
+	//! Buffer size
+    /*!
+      \return number of bytes in the buffer
+    */
+
+	UINT GetSize()
+	{return size;
+	}
+
+	//! Append raw data
+    /*!
+      \param p the data
+      \param count number of bytes
+    */
+
+	void Put(const void *p,UINT count)
+	{if (!count) return;
+	 if (data.size()<size+count) data.resize(size+count);
+	 memcpy(&data[size],p,count);
+	 size+=count;
+	}
+
+	//! Append an unsigned integer
+    /*!
+      \param value the value
+    */
+
+	void PutUINT(UINT value)
+	{Put(&value,sizeof(UINT));
+	}
+
+	//! Append a double
+    /*!
+      \param value the value
+    */
+
+	void PutDouble(double value)
+	{Put(&value,sizeof(double));
+	}
+
+	//! Append a string
+    /*!
+      Appends length and characters including the terminating zero
+      \param value the string
+      \sa StringSize()
+    */
+
+	void PutString(const OLECHAR *value)
+	{UINT length=(UINT)wcslen(value);
+	 PutUINT(length);
+	 Put(value,2*(length+1));
+	}
+
+	//! Size of a saved string
+    /*!
+      \param value the string
+      \return the number of bytes appended by PutString
+    */
+
+	static UINT StringSize(const OLECHAR *value)
+	{return sizeof(UINT)+2*((UINT)wcslen(value)+1);
+	}
+
+	//! Read raw data
+    /*!
+      \param p receives the data
+      \param count number of bytes
+      \return false if the data is not within the buffer
+    */
+
+	bool Get(void *p,UINT count)
+	{if (count>size-position) return false;
+	 if (count) memcpy(p,&data[position],count);
+	 position+=count;
+	 return true;
+	}
+
+	//! Read an unsigned integer
+    /*!
+      \param value receives the value
+      \return false if the data is not within the buffer
+    */
+
+	bool GetUINT(UINT &value)
+	{return Get(&value,sizeof(UINT));
+	}
+
+	//! Read a double
+    /*!
+      \param value receives the value
+      \return false if the data is not within the buffer
+    */
+
+	bool GetDouble(double &value)
+	{return Get(&value,sizeof(double));
+	}
+
+	//! Read a string
+    /*!
+      Reads a string saved by PutString, without intermediate allocation
+      \param value receives the string
+      \return false if the data is not within the buffer
+    */
+
+	bool GetString(wstring &value)
+	{UINT length;
+	 if (!GetUINT(length)) return false;
+	 UINT available=(size-position)/2; //characters remaining, including terminating zero
+	 if ((available==0)||(length>available-1)) return false;
+	 value.assign((const OLECHAR *)&data[position],length);
+	 position+=2*(length+1);
+	 return true;
+	}
+
+	//! Number of bytes not yet read
+    /*!
+      \return the number of bytes after the read position
+    */
+
+	UINT Remaining()
+	{return size-position;
+	}
+
+};
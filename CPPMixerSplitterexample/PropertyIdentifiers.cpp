@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "PropertyIdentifiers.h"
+
+BSTR ThermoIdentifiers::propertyNames[PROPERTYCOUNT];
+BSTR ThermoIdentifiers::basisNames[BASISCOUNT];
+BSTR ThermoIdentifiers::keywordNames[KEYWORDCOUNT];
+
+//strings, in order of the identifiers
+static const OLECHAR *propertyStrings[PROPERTYCOUNT]={L"pressure",L"temperature",L"totalFlow",L"fraction",L"phaseFraction",L"enthalpy"};
+static const OLECHAR *basisStrings[BASISCOUNT]={NULL,L"mole"};
+static const OLECHAR *keywordStrings[KEYWORDCOUNT]={NULL,L"overall",L"mixture",L"PH",L"TP",L"unspecified"};
+
+//! Thermo identifier table class
+/*!
+  Allocates the strings of ThermoIdentifiers when the module is loaded, and frees them when it is unloaded
+*/
+
+class ThermoIdentifierTable
+{	public:
+
+	//! Constructor
+    /*!
+      Allocates the strings
+    */
+
+	ThermoIdentifierTable()
+	{Allocate(ThermoIdentifiers::propertyNames,propertyStrings,PROPERTYCOUNT);
+	 Allocate(ThermoIdentifiers::basisNames,basisStrings,BASISCOUNT);
+	 Allocate(ThermoIdentifiers::keywordNames,keywordStrings,KEYWORDCOUNT);
+	}
+
+	//! Destructor
+    /*!
+      Frees the strings
+    */
+
+	~ThermoIdentifierTable()
+	{Free(ThermoIdentifiers::propertyNames,PROPERTYCOUNT);
+	 Free(ThermoIdentifiers::basisNames,BASISCOUNT);
+	 Free(ThermoIdentifiers::keywordNames,KEYWORDCOUNT);
+	}
+
+	private:
+
+	//! Allocate strings
+    /*!
+      \param names receives the BSTR values
+      \param strings the strings; NULL values remain NULL
+      \param count number of strings
+    */
+
+	static void Allocate(BSTR *names,const OLECHAR **strings,int count)
+	{int i;
+	 for (i=0;i<count;i++) names[i]=(strings[i])?SysAllocString(strings[i]):NULL;
+	}
+
+	//! Free strings
+    /*!
+      \param names the BSTR values
+      \param count number of strings
+    */
+
+	static void Free(BSTR *names,int count)
+	{int i;
+	 for (i=0;i<count;i++) 
+	  if (names[i]) 
+	   {SysFreeString(names[i]);
+	    names[i]=NULL;
+	   }
+	}
+
+};
+
+static ThermoIdentifierTable thermoIdentifierTable; /*!< the one and only instance, allocates the strings at module load */
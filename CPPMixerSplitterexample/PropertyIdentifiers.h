@@ -0,0 +1,103 @@
+#pragma once
+
+//! Property identifiers
+/*!
+  Properties that are used by this unit operation in calls to the material object
+  \sa ThermoIdentifiers
+*/
+
+enum ThermoProperty
+{	PROPERTY_PRESSURE,      /*!< pressure */
+	PROPERTY_TEMPERATURE,   /*!< temperature */
+	PROPERTY_TOTALFLOW,     /*!< totalFlow */
+	PROPERTY_FRACTION,      /*!< fraction */
+	PROPERTY_PHASEFRACTION, /*!< phaseFraction */
+	PROPERTY_ENTHALPY,      /*!< enthalpy */
+	PROPERTYCOUNT           /*!< number of properties */
+};
+
+//! Basis identifiers
+/*!
+  Bases of property values
+  \sa ThermoIdentifiers
+*/
+
+enum ThermoBasis
+{	BASIS_UNDEFINED,        /*!< no basis, for properties such as temperature and pressure; passed as NULL */
+	BASIS_MOLE,             /*!< mole */
+	BASISCOUNT              /*!< number of bases */
+};
+
+//! Keyword identifiers
+/*!
+  Other strings that are passed to the material object: the overall phase, 
+  the calculation type for version 1.0 thermo and flash specifications
+  \sa ThermoIdentifiers
+*/
+
+enum ThermoKeyword
+{	KEYWORD_NONE,           /*!< no value; passed as NULL */
+	KEYWORD_OVERALL,        /*!< overall, the phase for overall properties in version 1.0 thermo */
+	KEYWORD_MIXTURE,        /*!< mixture, the calculation type of mixture properties in version 1.0 thermo */
+	KEYWORD_PH,             /*!< PH, pressure-enthalpy flash in version 1.0 thermo */
+	KEYWORD_TP,             /*!< TP, temperature-pressure flash in version 1.0 thermo */
+	KEYWORD_UNSPECIFIED,    /*!< unspecified, the solution type of version 1.1 flash calculations */
+	KEYWORDCOUNT            /*!< number of keywords */
+};
+
+//! Thermo identifier table
+/*!
+  Table of the strings of the property, basis and keyword identifiers. The 
+  strings are allocated as BSTR values once, when the module is loaded, so 
+  that calls to the material object do not allocate a BSTR for every 
+  argument. Typing the Material interface on the identifiers turns a 
+  misspelled property name into a compile error.
+
+  The returned values are owned by the table; they can be passed as [in]
+  arguments, but must not be freed or modified.
+*/
+
+class ThermoIdentifiers
+{
+	static BSTR propertyNames[PROPERTYCOUNT]; /*!< strings for ThermoProperty */
+	static BSTR basisNames[BASISCOUNT]; /*!< strings for ThermoBasis; the first is NULL */
+	static BSTR keywordNames[KEYWORDCOUNT]; /*!< strings for ThermoKeyword; the first is NULL */
+
+	friend class ThermoIdentifierTable;
+
+	public:
+
+	//! String of a property
+    /*!
+      \param prop the property
+      \return the property name
+    */
+
+	static BSTR Name(ThermoProperty prop)
+	{ATLASSERT((prop>=0)&&(prop<PROPERTYCOUNT));
+	 return propertyNames[prop];
+	}
+
+	//! String of a basis
+    /*!
+      \param basis the basis
+      \return the basis, NULL for BASIS_UNDEFINED
+    */
+
+	static BSTR Name(ThermoBasis basis)
+	{ATLASSERT((basis>=0)&&(basis<BASISCOUNT));
+	 return basisNames[basis];
+	}
+
+	//! String of a keyword
+    /*!
+      \param keyword the keyword
+      \return the keyword, NULL for KEYWORD_NONE
+    */
+
+	static BSTR Name(ThermoKeyword keyword)
+	{ATLASSERT((keyword>=0)&&(keyword<KEYWORDCOUNT));
+	 return keywordNames[keyword];
+	}
+
+};
@@ -5,9 +5,30 @@
 
 #include "CPPMixerSplitterexample.h"
 #include "CAPEOPENBaseObject.h"
+#include "ObjectPool.h"
 
 #include <float.h>
 
+//! Real parameter specification
+/*!
+  Immutable definition of a real parameter: identification, bounds, default
+  value and dimensionality. Definitions are static tables of the unit 
+  operation, so that all instances of the unit operation share them; a 
+  parameter instance only holds its current value
+  \sa CRealParameter::CreateParameter()
+*/
+
+struct RealParameterSpec
+{const OLECHAR *name;        /*!< name of the parameter */
+ const OLECHAR *description; /*!< description of the parameter */
+ CapeParamMode mode;         /*!< CAPE_INPUT, or CAPE_OUTPUT for results of the calculation */
+ double minValue;            /*!< lower limit, can be NaN */
+ double maxValue;            /*!< upper limit, can be NaN */
+ double defaultValue;        /*!< default value; used to initialize as well, so cannot be NaN */
+ int dimensionCount;         /*!< number of values in dimensionality; trailing zeroes can be omitted */
+ double dimensionality[8];   /*!< m, kg, S, A, K, mole, cd, rad */
+};
+
 //! Real parameter class
 /*!
   CAPE-OPEN class that implements a real parameter.
@@ -20,6 +41,11 @@
   
   We ensure that the current value of the parameter is always valid.
   This way the implementation of the Validation is trivial
+  
+  The value can be accessed concurrently by the simulation environment
+  and by a calculating unit operation on another thread; it is protected
+  by the object lock. The unit operation accesses the value via GetValue 
+  and SetValue.
 */
 
 class ATL_NO_VTABLE CRealParameter :
@@ -31,43 +57,66 @@ class ATL_NO_VTABLE CRealParameter :
 {
 public:
 
-    double minVal; /*!< the upper limit of this parameter, can be NaN */
-    double maxVal; /*!< the lower limit of this parameter, can be NaN */
-    double defVal; /*!< the default value of this parameter; used to initialize as well, so cannot be NaN*/
+    const RealParameterSpec *spec; /*!< the immutable definition of this parameter, shared by all instances of the unit operation */
     double value;  /*!< the current value of this parameter, must always be valid */
-    CVariant dimensionality; /*!< the dimensionality of this parameter */
     CapeValidationStatus *valStatus; /*!< points to the unit operation's validation status */
 
 	//! Helper function for creating the parameter 
     /*!
       Helper function for creating the parameter as an exposable COM object. After calling CreateParameter, the reference
       count is one; do not delete the returned object. Use Release() instead
-      \param name name of the parameter
-      \param description description of the parameter
-      \param minVal the minimum value of the parameter
-      \param maxVal the maximum value of the parameter
-      \param defVal the default value of the parameter
-      \param dimensionality the dimensionality of this parameter      
+      \param spec definition of the parameter; must remain valid during the life time of the parameter
       \param valStatus points to the unit operation's validation status
       \sa CRealParameter()
     */
     
-    static CComObject<CRealParameter> *CreateParameter(const OLECHAR *name,const OLECHAR *description, double minVal, double maxVal, double defVal,vector<double> dimensionality,CapeValidationStatus *valStatus)
-    {unsigned int i;
-     CComObject<CRealParameter> *p;
+    static CComObject<CRealParameter> *CreateParameter(const RealParameterSpec *spec,CapeValidationStatus *valStatus)
+    {CComObject<CRealParameter> *p;
      CComObject<CRealParameter>::CreateInstance(&p); //create the instance with zero references
      p->AddRef(); //now it has one reference, the caller must Release this object
-     p->name=name;
-     p->description=description;
-     p->minVal=minVal;
-     p->maxVal=maxVal;
-     p->defVal=p->value=defVal;
-     p->dimensionality.MakeArray((int)dimensionality.size(),VT_R8);
+     p->spec=spec;
+     p->SetIdentification(spec->name,spec->description); //no copy is made
+     p->value=spec->defaultValue;
      p->valStatus=valStatus;
-     for (i=0;i<dimensionality.size();i++) p->dimensionality.SetDoubleAt(i,dimensionality[i]);
      return p;
     }
 
+	//! Get the current value
+    /*!
+      Thread-safe access to the current value of the parameter
+      \return the current value
+      \sa SetValue()
+    */
+
+    double GetValue()
+    {ObjectLock lock(this);
+     return value;
+    }
+
+	//! Set the current value
+    /*!
+      Thread-safe update of the current value of the parameter; the value is 
+      not checked against the bounds. The unit operation is not invalidated
+      \param newValue the new value
+      \sa GetValue()
+    */
+
+    void SetValue(double newValue)
+    {ObjectLock lock(this);
+     value=newValue;
+    }
+
+	//! Invalidate the unit operation
+    /*!
+      Sets the validation status of the unit operation to CAPE_NOT_VALIDATED. The 
+      status is shared with the unit operation that may be validating on another
+      thread, so it is changed with an interlocked operation
+    */
+
+    void InvalidateUnit()
+    {InterlockedExchange((volatile LONG*)valStatus,(LONG)CAPE_NOT_VALIDATED);
+    }
+
 	//! Constructor.
     /*!
       Creates an parameter of which the name cannot be changed by external applications.
@@ -96,6 +145,10 @@ public:
 
 	DECLARE_PROTECT_FINAL_CONSTRUCT()
 
+	//allocate from the object pool, as each unit operation creates many of these objects
+
+	DECLARE_POOLED_ALLOCATION()
+
 	// ICapeParameter Methods
 
 	//! ICapeParameter::get_Specification
@@ -123,7 +176,7 @@ public:
 	{	if (!value) return FALSE; //not a valid pointer
 		VARIANT res;
 		res.vt=VT_R8;
-		res.dblVal=this->value;
+		res.dblVal=GetValue();
 		*value=res;
 		return NOERROR;
 	}
@@ -143,6 +196,11 @@ public:
 	      return ECapeUnknownHR;
 	     }
 	    ATLASSERT(v.vt==VT_R8);
+	    //output parameters are set by the unit operation
+	    if (spec->mode==CAPE_OUTPUT)
+	     {SetError(L"This parameter is an output parameter and cannot be changed",L"ICapeParameter",L"put_value");
+	      return ECapeUnknownHR;
+	     }
 	    //check missing
 	    if (_isnan(v.dblVal))
 	     {//CAPE-OPEN value for missing number
@@ -150,19 +208,20 @@ public:
 	      return ECapeUnknownHR;
 	     }
 	    //check if in range
-	    if (!_isnan(minVal))
-	     if (v.dblVal<minVal)
+	    if (!_isnan(spec->minValue))
+	     if (v.dblVal<spec->minValue)
 	      {SetError(L"Invalid value: below minimum value",L"ICapeParameter",L"put_value");
  	       return ECapeUnknownHR;
 	      }
-	    if (!_isnan(maxVal))
-	     if (v.dblVal>maxVal)
+	    if (!_isnan(spec->maxValue))
+	     if (v.dblVal>spec->maxValue)
 	      {SetError(L"Invalid value: above maximum value",L"ICapeParameter",L"put_value");
  	       return ECapeUnknownHR;
 	      }
 	    //value is ok
+	    ObjectLock lock(this);
 	    this->value=v.dblVal;
-	    *valStatus=CAPE_NOT_VALIDATED; //we changed the parameter, the unit needs to be re-validated
+	    InvalidateUnit(); //we changed the parameter, the unit needs to be re-validated
 	    dirty=true; //something changed that affects saving
 		return NOERROR;
 	}
@@ -181,13 +240,13 @@ public:
 
 	//! ICapeParameter::get_Mode
     /*!
-      Get the mode. We only implement input parameters in this unit operation
+      Get the mode, from the parameter specification. Output parameters are set by the unit operation
       \param Mode [out, retval] receives the mode. Cannot be NULL
     */
 
 	STDMETHOD(get_Mode)(CapeParamMode * Mode)
 	{	if (!Mode) return E_POINTER; //not a valid value
-	    *Mode=CAPE_INPUT; //this unit operation only has input parameters
+	    *Mode=spec->mode;
 		return NOERROR;
 	}
 
@@ -222,8 +281,9 @@ public:
     */
 
 	STDMETHOD(Reset)()
-	{	value=defVal;
-	    *valStatus=CAPE_NOT_VALIDATED; //we changed the parameter, the unit needs to be re-validated
+	{	ObjectLock lock(this);
+	    value=spec->defaultValue;
+	    InvalidateUnit(); //we changed the parameter, the unit needs to be re-validated
 	    dirty=true; //something changed that affects saving
 		return NOERROR;
 	}
@@ -246,15 +306,19 @@ public:
     /*!
       Gets the dimensionality of this parameter. Order of values is 
       m, kg, S, A, K, mole, cd, rad, optionally followed by a delta indicator.
-      All trailing zeroes can be ommited; the returned data is initialized in 
-      CreateParameter.
+      All trailing zeroes can be ommited; the returned data is taken from the
+      parameter specification.
       \param dim [out, retval] receives the dimensionality. Cannot be NULL.
       \sa CreateParameter()
     */
 
 	STDMETHOD(get_Dimensionality)(VARIANT * dim)
 	{	if (!dim) return E_POINTER; //not a valid pointer
-	    *dim=dimensionality.Copy(); //caller must free the result
+	    int i;
+	    CVariant dimensionality;
+	    dimensionality.MakeArray(spec->dimensionCount,VT_R8);
+	    for (i=0;i<spec->dimensionCount;i++) dimensionality.SetDoubleAt(i,spec->dimensionality[i]);
+	    *dim=dimensionality.ReturnValue(); //caller must free the result
 		return NOERROR;
 	}
 
@@ -268,7 +332,7 @@ public:
 
 	STDMETHOD(get_DefaultValue)(double * DefaultValue)
 	{	if (!DefaultValue) return E_POINTER; //not a valid pointer
-	    *DefaultValue=defVal;
+	    *DefaultValue=spec->defaultValue;
 		return NOERROR;
 	}
 
@@ -281,7 +345,7 @@ public:
 
 	STDMETHOD(get_LowerBound)(double * lBound)
 	{	if (!lBound) return E_POINTER; //not a valid pointer
-	    *lBound=minVal;
+	    *lBound=spec->minValue;
 		return NOERROR;
 	}
 
@@ -294,7 +358,7 @@ public:
 
 	STDMETHOD(get_UpperBound)(double * uBound)
 	{	if (!uBound) return E_POINTER; //not a valid pointer
-	    *uBound=maxVal;
+	    *uBound=spec->maxValue;
 		return NOERROR;
 	}
 
@@ -323,16 +387,16 @@ public:
 	     }
 	    if (*isOK)
 	     {//check min
-	      if (!_isnan(minVal))
-	       if (value<minVal)
+	      if (!_isnan(spec->minValue))
+	       if (value<spec->minValue)
 	        {*message=SysAllocString(L"Value is below minimum value"); //caller must SysFreeString this value
 	         *isOK=VARIANT_FALSE;
 	        }
 	     }
 	    if (*isOK)
 	     {//check max
-	      if (!_isnan(maxVal))
-	       if (value>maxVal)
+	      if (!_isnan(spec->maxValue))
+	       if (value>spec->maxValue)
 	        {*message=SysAllocString(L"Value is above minimum value"); //caller must SysFreeString this value
 	         *isOK=VARIANT_FALSE;
 	        }
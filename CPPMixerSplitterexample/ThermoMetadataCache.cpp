@@ -0,0 +1,199 @@
+#include "stdafx.h"
+#include "ThermoMetadataCache.h"
+#include "Material.h"
+
+CComAutoCriticalSection ThermoMetadataCache::lock;
+vector<ThermoMetadata *> ThermoMetadataCache::entries;
+
+//! Add a reference
+/*!
+
+  Adds a reference to the metadata
+  \sa Release()
+
+*/
+
+void ThermoMetadata::AddRef()
+{CComCritSecLock<CComAutoCriticalSection> cacheLock(ThermoMetadataCache::lock);
+ refCount++;
+}
+
+//! Release a reference
+/*!
+
+  Releases a reference to the metadata. If this was the last reference, the
+  metadata is removed from the cache and destroyed. The reference count is
+  maintained under the cache lock, so that the cache never hands out an entry
+  that is being destroyed.
+  \sa AddRef()
+
+*/
+
+void ThermoMetadata::Release()
+{unsigned int i;
+ CComCritSecLock<CComAutoCriticalSection> cacheLock(ThermoMetadataCache::lock);
+ if (--refCount==0)
+  {for (i=0;i<ThermoMetadataCache::entries.size();i++)
+    if (ThermoMetadataCache::entries[i]==this)
+     {ThermoMetadataCache::entries.erase(ThermoMetadataCache::entries.begin()+i);
+      break;
+     }
+   delete this;
+  }
+}
+
+//! Compare compound lists
+/*!
+
+  Checks whether two metadata entries have the same compound list. Entries of
+  different property packages may still have the same compound list.
+  \param other the entry to compare with
+  \return true if the compound lists are the same
+
+*/
+
+bool ThermoMetadata::SameCompounds(ThermoMetadata *other)
+{if (other==this) return true;
+ return ThermoMetadataCache::SameList(compoundIDs,other->compoundIDs);
+}
+
+//! Compare string lists
+/*!
+
+  Case-insensitive comparison of two lists of strings; the strings are compared in place
+  \param list1 first list, checked to be a string array
+  \param list2 second list, checked to be a string array
+  \return true if the lists are the same
+
+*/
+
+bool ThermoMetadataCache::SameList(CVariant &list1,CVariant &list2)
+{int i;
+ if (list1.GetCount()!=list2.GetCount()) return false;
+ for (i=0;i<list1.GetCount();i++)
+  if (!CBSTR::Same(list1.GetStringViewAt(i),list2.GetStringViewAt(i))) return false; //no copies of the strings
+ return true;
+}
+
+//! Hash a string list
+/*!
+
+  Adds a list of strings to a hash; the strings are hashed in upper case, consistent with
+  the case-insensitive comparison of SameList()
+  \param hash the hash to update
+  \param list the list, checked to be a string array
+  \sa ConvergedState::Hash()
+
+*/
+
+void ThermoMetadataCache::HashList(ULONGLONG &hash,CVariant &list)
+{int i;
+ const OLECHAR *s;
+ OLECHAR c;
+ for (i=0;i<list.GetCount();i++)
+  {s=list.GetStringViewAt(i);
+   if (s)
+    for (;*s;s++)
+     {c=towupper(*s);
+      ConvergedState::Hash(hash,&c,sizeof(OLECHAR));
+     }
+   c=0; //separator
+   ConvergedState::Hash(hash,&c,sizeof(OLECHAR));
+  }
+}
+
+//! Find an entry
+/*!
+
+  Finds an entry in the cache and adds a reference to it. Must be called with the cache lock held.
+  \param thermoVersion the thermo version
+  \param compoundIDs the compound IDs
+  \param phaseLabels the labels of all possible phases
+  \return the entry, or NULL if not found
+
+*/
+
+ThermoMetadata *ThermoMetadataCache::Find(int thermoVersion,CVariant &compoundIDs,CVariant &phaseLabels)
+{unsigned int i;
+ ThermoMetadata *md;
+ for (i=0;i<entries.size();i++)
+  {md=entries[i];
+   if (md->thermoVersion!=thermoVersion) continue;
+   if (!SameList(md->compoundIDs,compoundIDs)) continue;
+   if (!SameList(md->phaseLabels,phaseLabels)) continue;
+   md->refCount++;
+   return md;
+  }
+ return NULL;
+}
+
+//! Get the metadata for a material
+/*!
+
+  Gets the metadata of the property package of a material. The compound IDs and the
+  list of possible phases are obtained from the material to identify the property
+  package; if an entry for this property package exists, it is returned. Otherwise
+  the remaining metadata is obtained from the material and a new entry is added to
+  the cache.
+  \param material the material, may be connected to a feed port
+  \param error receives the error description in case of failure
+  \return the metadata, which must be released by the caller, or NULL in case of failure
+
+*/
+
+ThermoMetadata *ThermoMetadataCache::Acquire(Material &material,wstring &error)
+{int i;
+ int thermoVersion;
+ CVariant compoundIDs,phaseLabels,propList;
+ ThermoMetadata *md,*existing;
+ //identify the property package
+ thermoVersion=material.GetThermoVersion();
+ if (!material.GetCompoundIDs(compoundIDs,error)) return NULL;
+ if (!material.GetPhaseList(phaseLabels,error)) return NULL;
+ lock.Lock();
+ md=Find(thermoVersion,compoundIDs,phaseLabels);
+ lock.Unlock();
+ if (md) return md;
+ //not in the cache; get the remaining metadata without holding the lock, as this calls the material object
+ if (!material.GetSinglePhasePropList(propList,error)) return NULL;
+ md=new ThermoMetadata;
+ md->thermoVersion=thermoVersion;
+ md->compoundIDs.Set(compoundIDs.ReturnValue(),TRUE);
+ md->compoundIDs.CheckArray(VT_BSTR,error); //sets the count, checked by the material
+ md->phaseLabels.Set(phaseLabels.ReturnValue(),TRUE);
+ md->phaseLabels.CheckArray(VT_BSTR,error); //sets the count, checked by the material
+ md->phaseStatus.MakeArray(md->phaseLabels.GetCount(),VT_I4);
+ for (i=0;i<md->phaseLabels.GetCount();i++) md->phaseStatus.SetLongAt(i,CAPE_UNKNOWNPHASESTATUS); //we do not have an initial guess
+ md->identity=14695981039346656037ui64; //FNV offset basis
+ ConvergedState::Hash(md->identity,&thermoVersion,sizeof(int));
+ HashList(md->identity,md->compoundIDs);
+ HashList(md->identity,md->phaseLabels);
+ for (i=0;i<propList.GetCount();i++)
+  {if (CBSTR::Same(propList.GetStringViewAt(i),ThermoIdentifiers::Name(PROPERTY_ENTHALPY))) //comparison is case-insensitive
+    {md->enthalpyAvailable=true;
+     break;
+    }
+  }
+ //add to the cache, unless another thread added the same entry in the mean time
+ lock.Lock();
+ existing=Find(thermoVersion,md->compoundIDs,md->phaseLabels);
+ if (!existing) entries.push_back(md);
+ lock.Unlock();
+ if (existing)
+  {delete md; //not in the cache, reference count is not shared
+   md=existing;
+  }
+ return md;
+}
+
+//! Number of cached entries
+/*!
+
+  \return the number of property packages in the cache
+
+*/
+
+int ThermoMetadataCache::GetEntryCount()
+{CComCritSecLock<CComAutoCriticalSection> cacheLock(lock);
+ return (int)entries.size();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+class Material;
+
+//! Thermo metadata class
+/*!
+  Holds the metadata of a property package, as seen through a material object:
+  the compound IDs, the phase labels and whether enthalpy is available. The
+  metadata is immutable after construction and is shared between all unit
+  operation instances in this process that use the same property package,
+  so it can be read from any thread without locking.
+
+  The phase labels and the corresponding phase status values are kept as
+  ready-made VARIANTs, so that flash calculations on version 1.1 material
+  objects do not need to obtain the list of possible phases on every call.
+
+  Do not create this object directly; it is obtained via
+  ThermoMetadataCache::Acquire(). The object is reference counted; each
+  reference obtained from the cache or by AddRef() must be released by
+  Release().
+
+  \sa ThermoMetadataCache
+*/
+
+class ThermoMetadata
+{	friend class ThermoMetadataCache;
+
+	LONG refCount; /*!< reference count; protected by the cache lock */
+
+	//! Constructor
+    /*!
+      Creates an empty entry with a reference count of one
+    */
+
+	ThermoMetadata()
+	{refCount=1;
+	 thermoVersion=0;
+	 enthalpyAvailable=false;
+	 identity=0;
+	}
+
+	public:
+
+	int thermoVersion; /*!< CAPE-OPEN thermo version of the material objects, 10 or 11 */
+	CVariant compoundIDs; /*!< the compound IDs; the strings are shared by all users of the property package */
+	CVariant phaseLabels; /*!< the labels of all possible phases; empty for version 1.0 thermo */
+	CVariant phaseStatus; /*!< phase status for each phase label, all CAPE_UNKNOWNPHASESTATUS; for setting all phases present before a flash */
+	bool enthalpyAvailable; /*!< set if enthalpy is in the list of single phase properties */
+	ULONGLONG identity; /*!< hash of the thermo version, compound IDs and phase labels; identifies the compounds and phases of the property package, not its models */
+
+	void AddRef();
+	void Release();
+	bool SameCompounds(ThermoMetadata *other);
+
+};
+
+//! Thermo metadata cache class
+/*!
+  Process-wide cache of thermo metadata, shared by all instances of the unit
+  operation. A large flowsheet typically contains many unit operations that
+  use the same property package; the cache makes sure that the metadata of
+  such a property package is obtained and stored only once.
+
+  CAPE-OPEN does not expose the identity of the property package behind a
+  material object. An entry is therefore identified by the thermo version,
+  the compound IDs and the list of possible phases; material objects that
+  agree on all of these are considered to use the same property package.
+
+  Entries are reference counted and are removed from the cache when the
+  last reference is released. All functions are thread-safe.
+
+  \sa ThermoMetadata
+*/
+
+class ThermoMetadataCache
+{	friend class ThermoMetadata;
+
+	static CComAutoCriticalSection lock; /*!< protects the list of entries and the reference counts of the entries */
+	static vector<ThermoMetadata *> entries; /*!< the entries in the cache */
+
+	static ThermoMetadata *Find(int thermoVersion,CVariant &compoundIDs,CVariant &phaseLabels);
+	static bool SameList(CVariant &list1,CVariant &list2);
+	static void HashList(ULONGLONG &hash,CVariant &list);
+
+	public:
+
+	static ThermoMetadata *Acquire(Material &material,wstring &error);
+	static int GetEntryCount();
+
+};
@@ -69,7 +69,55 @@ public:
 
     CVariant(CVariant &orig)
      {mustDelete=TRUE;
+      VariantInit(&value);
       VariantCopy(&value,&orig.value);
+      count=orig.count;
+      #ifdef _DEBUG
+      elementType=orig.elementType;
+      #endif
+     }
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1600)
+
+	//! Move constructor.
+    /*!
+      Takes over the value of a temporary without copying its content
+    */
+
+    CVariant(CVariant &&orig)
+     {mustDelete=orig.mustDelete;
+      value=orig.value;
+      count=orig.count;
+      #ifdef _DEBUG
+      elementType=orig.elementType;
+      #endif
+      VariantInit(&orig.value);
+      orig.count=0;
+     }
+
+#endif
+
+	//! Swap
+    /*!
+      Exchanges the values of two CVariant objects, without copying their content
+      \param other the value to swap with
+    */
+
+    void Swap(CVariant &other)
+     {VARIANT v=value;
+      BOOL b=mustDelete;
+      LONG c=count;
+      value=other.value;
+      mustDelete=other.mustDelete;
+      count=other.count;
+      other.value=v;
+      other.mustDelete=b;
+      other.count=c;
+      #ifdef _DEBUG
+      VARTYPE vt=elementType;
+      elementType=other.elementType;
+      other.elementType=vt;
+      #endif
      }
     
 	//! Destructor.
@@ -273,6 +321,24 @@ public:
       return res;
      }
 
+	//! Access elements of string arrays without copying
+    /*!
+     function to get the elements of string arrays, without allocating a copy of the string. 
+     Use this for comparisons, or to pass the string as [in] argument.
+     \param index should be between 0 and count-1, inclusive
+     \return value at specified index, owned by this object; valid until the array is changed or destroyed
+     \sa GetStringAt()
+    */
+
+    BSTR GetStringViewAt(LONG index)
+     {//make sure CheckArray was called before this
+      BSTR *b;
+      ATLASSERT((count>0)&&(index<count));
+      ATLASSERT(elementType==VT_BSTR);
+      if (FAILED(SafeArrayPtrOfIndex(value.parray,&index,(void**)&b))) return NULL;
+      return *b;
+     }
+
 	//! Access elements of integer arrays
     /*!
      function to set the elements of integer arrays. 